@@ -0,0 +1,384 @@
+// NeonPostgresOverHTTP example - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+// ---------------------------------------------------------------------------------------------------------
+// Benchmarks for the library, they do not need any sensors or actuators connected to your microcontroller.
+// Runs unchanged on Arduino Nano RP2040 Connect (WiFiNINA) and ESP32 boards like the XIAO ESP32C6
+// and prints the results to the serial monitor:
+// - latency distribution of single-row INSERT statements
+// - throughput of batched inserts as one multi-row INSERT and as one transaction
+// - parse time and memory of SELECT results of increasing size
+// With BENCH_STORE_RESULTS set to 1 the results are also stored in the table bench_results,
+// so runs on different boards and library versions can be compared with SQL.
+// ---------------------------------------------------------------------------------------------------------
+
+// Example output in serial monitor:
+// Board: ESP32
+// benchmark            param      min ms   p50 ms   p99 ms   max ms   result bytes
+// insert                  32          61       74      210      210            488
+// batch values            20 rows:  20 in 98 ms, 204.1 rows/s
+// batch transaction       20 rows:  20 in 131 ms, 152.7 rows/s
+// select rows              1          63       66       70       70            656
+// select rows             10          67       71       82       82           1632
+// ...
+
+#include <SPI.h>
+#if defined(ARDUINO_ARCH_ESP32)
+#include <WiFi.h>  // for XIAO ESP32 C6
+#include <WiFiClientSecure.h>
+#else
+#include <WiFiNINA.h>  // for Arduino Nano RP2040 Connect
+#endif
+#include "arduino_secrets.h"  // copy arduino_secrets.h.example to arduino_secrets.h and fill in your secrets
+// record the duration of the phases of each request, see NeonPostgresOverHTTPProxyClient::getLastTimings()
+#define NEON_POSTGRES_INSTRUMENTATION
+#include <NeonPostgresOverHTTP.h>
+#include <NeonPostgresBatchInsert.h>
+
+// number of requests per measurement
+#define BENCH_ITERATIONS 20
+// size of the text parameter of the single-row INSERT benchmark in bytes
+#define BENCH_PAYLOAD_BYTES 32
+// number of rows per batch of the batch benchmarks
+#define BENCH_BATCH_ROWS 20
+// size of the text column of each row in the SELECT benchmark in bytes
+#define BENCH_SELECT_ROW_BYTES 32
+// set to 1 to also store the results in the table bench_results
+#define BENCH_STORE_RESULTS 0
+
+#if defined(ARDUINO_ARCH_ESP32)
+const char* board = "ESP32";
+WiFiClientSecure client;
+#else
+const char* board = "RP2040 Connect";
+WiFiSSLClient client;
+#endif
+
+///////please enter your sensitive data in the Secret tab/arduino_secrets.h
+char ssid[] = SECRET_SSID;  // your network SSID (name)
+char pass[] = SECRET_PASS;  // your network password (use for WPA, or use as key for WEP)
+
+int status = WL_IDLE_STATUS;
+
+NeonPostgresOverHTTPProxyClient sqlClient(client, DATABASE_URL, NEON_PROXY);
+
+const char* createTables = R"SQL(
+CREATE TABLE if not exists bench_values(
+  measure_time timestamp without time zone DEFAULT now() NOT NULL,
+  sensor_name text NOT NULL, sensor_value float
+)
+)SQL";
+
+const char* createResults = R"SQL(
+CREATE TABLE if not exists bench_results(
+  run_time timestamp without time zone DEFAULT now() NOT NULL,
+  board text NOT NULL, benchmark text NOT NULL, param int,
+  min_ms float, p50_ms float, p99_ms float, max_ms float, result_bytes int, rows_per_second float
+)
+)SQL";
+
+const char* insertValue = R"SQL(
+INSERT INTO bench_values (sensor_name, sensor_value) VALUES ($1::text, $2::float)
+)SQL";
+
+const char* selectRows = R"SQL(
+SELECT g AS id, repeat('x', $2::int) AS payload FROM generate_series(1, $1::int) AS g
+)SQL";
+
+const char* insertResult = R"SQL(
+INSERT INTO bench_results (board, benchmark, param, min_ms, p50_ms, p99_ms, max_ms, result_bytes, rows_per_second)
+VALUES ($1::text, $2::text, $3::int, $4::float, $5::float, $6::float, $7::float, $8::int, $9::float)
+)SQL";
+
+const char* batchColumns[] = { "sensor_name", "sensor_value" };
+const char* batchTypes[] = { "text", "float" };
+typedef NeonPostgresBatchInsert<BENCH_BATCH_ROWS, 2> BenchBatch;
+BenchBatch valuesBatch(sqlClient, "bench_values", batchColumns, batchTypes);
+BenchBatch transactionBatch(sqlClient, "bench_values", batchColumns, batchTypes, BenchBatch::Transaction);
+
+// latencies of the last measurement in milliseconds
+float latencies[BENCH_ITERATIONS];
+
+struct Summary {
+  float minMs;
+  float p50Ms;
+  float p99Ms;
+  float maxMs;
+  size_t resultBytes;
+};
+
+void setup() {
+  //Initialize serial and wait for port to open:
+  Serial.begin(9600);
+  while (!Serial) {
+    ;  // wait for serial port to connect. Needed for native USB port only
+  }
+  connectWiFi();
+
+  // reuse the connection, connection setup is measured separately by the first request
+  sqlClient.setKeepAlive(true);
+
+  executeOrPrint(createTables);
+#if BENCH_STORE_RESULTS
+  executeOrPrint(createResults);
+#endif
+}
+
+void loop() {
+  Serial.print("\nBoard: ");
+  Serial.println(board);
+  Serial.println("benchmark            param      min ms   p50 ms   p99 ms   max ms   result bytes");
+
+  benchmarkInsert(BENCH_PAYLOAD_BYTES);
+  benchmarkBatch("batch values", valuesBatch);
+  benchmarkBatch("batch transaction", transactionBatch);
+  const int rowCounts[] = { 1, 10, 50, 100 };
+  for (int rows : rowCounts) {
+    benchmarkSelect(rows);
+  }
+  printCounters();
+
+  // wait a minute before the next run
+  delay(60000);
+}
+
+// single-row INSERT latency with a text parameter of payloadBytes bytes
+void benchmarkInsert(int payloadBytes) {
+  char payload[BENCH_PAYLOAD_BYTES + 1];
+  memset(payload, 'x', payloadBytes);
+  payload[payloadBytes] = 0;
+  size_t resultBytes = 0;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    sqlClient.setQuery(insertValue);
+    JsonArray params = sqlClient.getParams();
+    params.add(payload);
+    params.add(i);
+    if (!measure(i, resultBytes)) {
+      return;
+    }
+  }
+  report("insert", payloadBytes, summarize(resultBytes), 0);
+}
+
+// throughput of BENCH_BATCH_ROWS rows sent with one request
+void benchmarkBatch(const char* name, BenchBatch& batch) {
+  for (int i = 0; i < BENCH_BATCH_ROWS; i++) {
+    batch.append("bench", static_cast<float>(i));
+  }
+  unsigned long start = millis();
+  NeonBatchResult result = batch.flush();
+  unsigned long elapsed = millis() - start;
+  if (result.errorMessage != nullptr) {
+    Serial.println(result.errorMessage);
+    return;
+  }
+  float rowsPerSecond = elapsed > 0 ? 1000.0 * result.rows / elapsed : 0;
+  Serial.print(pad(name, 20));
+  Serial.print(pad(BENCH_BATCH_ROWS, 6));
+  Serial.print(" rows: ");
+  Serial.print(result.rowsAffected);
+  Serial.print(" in ");
+  Serial.print(elapsed);
+  Serial.print(" ms, ");
+  Serial.print(rowsPerSecond);
+  Serial.println(" rows/s");
+  Summary summary = { static_cast<float>(elapsed), static_cast<float>(elapsed), static_cast<float>(elapsed),
+                      static_cast<float>(elapsed), sqlClient.getLastTimings().resultMemory };
+  storeResult(name, BENCH_BATCH_ROWS, summary, rowsPerSecond);
+}
+
+// parse time and memory of a result with rows rows
+void benchmarkSelect(int rows) {
+  size_t resultBytes = 0;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    sqlClient.setQuery(selectRows);
+    JsonArray params = sqlClient.getParams();
+    params.add(rows);
+    params.add(BENCH_SELECT_ROW_BYTES);
+    if (!measure(i, resultBytes)) {
+      return;
+    }
+    if (sqlClient.getRowCount() != rows) {
+      Serial.println("unexpected row count");
+      return;
+    }
+  }
+  report("select rows", rows, summarize(resultBytes), 0);
+  const NeonRequestTimings& timings = sqlClient.getLastTimings();
+  Serial.print("  last request: wait ");
+  Serial.print(timings.waitMicros);
+  Serial.print(" us, parse ");
+  Serial.print(timings.parseMicros);
+  Serial.print(" us, received ");
+  Serial.print(timings.bytesReceived);
+  Serial.println(" bytes");
+}
+
+// execute the statement set with setQuery() and record its latency as measurement i
+bool measure(int i, size_t& resultBytes) {
+  const char* errorMessage = sqlClient.execute();
+  if (errorMessage != nullptr) {
+    Serial.println(errorMessage);
+    checkWiFi();
+    return false;
+  }
+  const NeonRequestTimings& timings = sqlClient.getLastTimings();
+  latencies[i] = timings.totalMicros / 1000.0;
+  if (timings.resultMemory > resultBytes) {
+    resultBytes = timings.resultMemory;
+  }
+  return true;
+}
+
+Summary summarize(size_t resultBytes) {
+  // insertion sort, BENCH_ITERATIONS is small
+  for (int i = 1; i < BENCH_ITERATIONS; i++) {
+    float value = latencies[i];
+    int j = i - 1;
+    while (j >= 0 && latencies[j] > value) {
+      latencies[j + 1] = latencies[j];
+      j--;
+    }
+    latencies[j + 1] = value;
+  }
+  Summary summary;
+  summary.minMs = latencies[0];
+  summary.p50Ms = latencies[BENCH_ITERATIONS / 2];
+  summary.p99Ms = latencies[(BENCH_ITERATIONS * 99 + 99) / 100 - 1];
+  summary.maxMs = latencies[BENCH_ITERATIONS - 1];
+  summary.resultBytes = resultBytes;
+  return summary;
+}
+
+void report(const char* name, int param, const Summary& summary, float rowsPerSecond) {
+  Serial.print(pad(name, 20));
+  Serial.print(pad(param, 6));
+  Serial.print(pad(summary.minMs, 12));
+  Serial.print(pad(summary.p50Ms, 9));
+  Serial.print(pad(summary.p99Ms, 9));
+  Serial.print(pad(summary.maxMs, 9));
+  Serial.println(pad(static_cast<int>(summary.resultBytes), 15));
+  storeResult(name, param, summary, rowsPerSecond);
+}
+
+void storeResult(const char* name, int param, const Summary& summary, float rowsPerSecond) {
+#if BENCH_STORE_RESULTS
+  sqlClient.setQuery(insertResult);
+  JsonArray params = sqlClient.getParams();
+  params.add(board);
+  params.add(name);
+  params.add(param);
+  params.add(summary.minMs);
+  params.add(summary.p50Ms);
+  params.add(summary.p99Ms);
+  params.add(summary.maxMs);
+  params.add(summary.resultBytes);
+  params.add(rowsPerSecond);
+  const char* errorMessage = sqlClient.execute();
+  if (errorMessage != nullptr) {
+    Serial.println(errorMessage);
+  }
+#else
+  (void)name;
+  (void)param;
+  (void)summary;
+  (void)rowsPerSecond;
+#endif
+}
+
+void printCounters() {
+  const NeonRequestCounters& counters = sqlClient.getCounters();
+  Serial.print("requests: ");
+  Serial.print(counters.requests);
+  Serial.print(" failures: ");
+  Serial.print(counters.failures);
+  Serial.print(" connects: ");
+  Serial.print(counters.connects);
+  Serial.print(" p50: <");
+  Serial.print(sqlClient.getLatencyPercentile(50));
+  Serial.print(" ms p99: <");
+  Serial.print(sqlClient.getLatencyPercentile(99));
+  Serial.println(" ms");
+#if defined(ARDUINO_ARCH_ESP32)
+  // heap high-watermark of the whole program
+  Serial.print("free heap: ");
+  Serial.print(ESP.getFreeHeap());
+  Serial.print(" minimum free heap: ");
+  Serial.println(ESP.getMinFreeHeap());
+#endif
+}
+
+String rightAlign(const String& value, unsigned int width) {
+  String padded = value;
+  while (padded.length() < width) {
+    padded = " " + padded;
+  }
+  return padded;
+}
+
+// strings are left aligned, numbers right aligned
+String pad(const char* value, unsigned int width) {
+  String padded = value;
+  while (padded.length() < width) {
+    padded += " ";
+  }
+  return padded;
+}
+
+String pad(int value, unsigned int width) {
+  return rightAlign(String(value), width);
+}
+
+String pad(float value, unsigned int width) {
+  return rightAlign(String(value, 0), width);
+}
+
+void executeOrPrint(const char* statement) {
+  sqlClient.setQuery(statement);
+  const char* errorMessage = sqlClient.execute();
+  while (errorMessage != nullptr) {
+    Serial.println(errorMessage);
+    checkWiFi();
+    errorMessage = sqlClient.execute();
+  }
+}
+
+void connectWiFi() {
+#if defined(ARDUINO_ARCH_ESP32)
+  WiFi.mode(WIFI_STA);
+  status = WiFi.begin(ssid, pass);
+  WiFi.setSleep(false);
+  while (status != WL_CONNECTED) {
+    delay(1000);
+    Serial.print("Waiting to connect to SSID: ");
+    Serial.println(ssid);
+    status = WiFi.status();
+  }
+  client.setInsecure();  // avoid cert validation
+#else
+  // check for the WiFi module:
+  if (WiFi.status() == WL_NO_MODULE) {
+    Serial.println("Communication with WiFi module failed!");
+    // don't continue
+    while (true)
+      ;
+  }
+  while (status != WL_CONNECTED) {
+    Serial.print("Attempting to connect to SSID: ");
+    Serial.println(ssid);
+    status = WiFi.begin(ssid, pass);
+    if (status != WL_CONNECTED) {
+      delay(10000);
+    }
+  }
+#endif
+  Serial.println("Connected to WiFi");
+}
+
+void checkWiFi() {
+  if (WiFi.status() != WL_CONNECTED) {
+    sqlClient.closeConnection();
+    connectWiFi();
+  }
+}
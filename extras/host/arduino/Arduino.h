@@ -0,0 +1,268 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+// Minimal Arduino API for building the library on a Linux or macOS host, see extras/host/README.md.
+// Only what the library and ArduinoJson use is provided.
+
+#ifndef NEON_HOST_ARDUINO_H
+#define NEON_HOST_ARDUINO_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <thread>
+
+inline unsigned long micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return static_cast<unsigned long>(
+    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+inline unsigned long millis() {
+  return micros() / 1000;
+}
+
+inline void delay(unsigned long ms) {
+  if (ms > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+inline void yield() {}
+
+// random number in [0, max)
+inline long random(long max) {
+  return max > 0 ? static_cast<long>(::random() % max) : 0;
+}
+
+class String {
+public:
+  String(const char* value = "")
+    : value(value != nullptr ? value : "") {}
+  String(int value)
+    : value(std::to_string(value)) {}
+  String(unsigned long value)
+    : value(std::to_string(value)) {}
+
+  const char* c_str() const {
+    return value.c_str();
+  }
+  unsigned int length() const {
+    return value.size();
+  }
+  bool reserve(unsigned int size) {
+    value.reserve(size);
+    return true;
+  }
+  bool concat(const char* s) {
+    value += s;
+    return true;
+  }
+  bool concat(char c) {
+    value += c;
+    return true;
+  }
+  String& operator=(const char* s) {
+    value = s;
+    return *this;
+  }
+  String& operator+=(const char* s) {
+    value += s;
+    return *this;
+  }
+  String& operator+=(const String& s) {
+    value += s.value;
+    return *this;
+  }
+  String& operator+=(char c) {
+    value += c;
+    return *this;
+  }
+  String& operator+=(unsigned long n) {
+    value += std::to_string(n);
+    return *this;
+  }
+  String& operator+=(int n) {
+    value += std::to_string(n);
+    return *this;
+  }
+  bool operator==(const char* s) const {
+    return value == s;
+  }
+
+private:
+  std::string value;
+};
+
+// ArduinoJson refers to it in its String adapter
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const char* value = "")
+    : String(value) {}
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size-- > 0 && write(*buffer++) == 1) {
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char* s) {
+    return write(reinterpret_cast<const uint8_t*>(s), strlen(s));
+  }
+  size_t write(const char* buffer, size_t size) {
+    return write(reinterpret_cast<const uint8_t*>(buffer), size);
+  }
+  virtual void flush() {}
+
+  size_t print(const char* s) {
+    return write(s);
+  }
+  size_t print(const String& s) {
+    return write(s.c_str());
+  }
+  size_t print(char c) {
+    return write(static_cast<uint8_t>(c));
+  }
+  size_t print(int n) {
+    return print(static_cast<long>(n));
+  }
+  size_t print(unsigned int n) {
+    return print(static_cast<unsigned long>(n));
+  }
+  size_t print(long n) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%ld", n);
+    return write(buffer);
+  }
+  size_t print(unsigned long n) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%lu", n);
+    return write(buffer);
+  }
+  size_t print(unsigned long long n) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%llu", n);
+    return write(buffer);
+  }
+  size_t print(double n, int digits = 2) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+    return write(buffer);
+  }
+  size_t println() {
+    return write("\r\n");
+  }
+  template <typename T>
+  size_t println(const T& value) {
+    size_t n = print(value);
+    return n + println();
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) {
+    this->timeout = timeout;
+  }
+  unsigned long getTimeout() {
+    return timeout;
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+      int c = timedRead();
+      if (c < 0) {
+        break;
+      }
+      buffer[n++] = static_cast<char>(c);
+    }
+    return n;
+  }
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    return readBytes(reinterpret_cast<char*>(buffer), length);
+  }
+
+protected:
+  int timedRead() {
+    unsigned long start = millis();
+    do {
+      int c = read();
+      if (c >= 0) {
+        return c;
+      }
+      yield();
+    } while (millis() - start < timeout);
+    return -1;
+  }
+
+  unsigned long timeout = 1000;
+};
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0)
+    : bytes{ a, b, c, d } {}
+  uint8_t operator[](int i) const {
+    return bytes[i];
+  }
+
+private:
+  uint8_t bytes[4];
+};
+
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char* host, uint16_t port) = 0;
+  using Print::write;
+  virtual int read(uint8_t* buffer, size_t size) = 0;
+  using Stream::read;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
+
+// Serial writes to stdout
+class HostSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override {
+    return fwrite(&c, 1, 1, stdout);
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    return fwrite(buffer, 1, size, stdout);
+  }
+  int available() override {
+    return 0;
+  }
+  int read() override {
+    return -1;
+  }
+  int peek() override {
+    return -1;
+  }
+  operator bool() {
+    return true;
+  }
+};
+
+static HostSerial Serial;
+
+#endif /* NEON_HOST_ARDUINO_H */
@@ -0,0 +1,200 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+// Mock WiFiClient for host builds: records the requests and replays recorded proxy responses,
+// see extras/host/README.md.
+
+#ifndef NEON_HOST_WIFICLIENT_H
+#define NEON_HOST_WIFICLIENT_H
+
+#include <deque>
+#include <string>
+#include "Arduino.h"
+
+class WiFiClient : public Client {
+public:
+  /**
+     * @brief Queue a raw HTTP response (status line, headers and body), it is returned for the next request.
+     *        Queued responses take precedence over the one set with setResponse().
+     *
+     * @param response the response. This pointer must be valid until the response has been read, it is NOT copied
+     */
+  void addResponse(const char* response) {
+    queued.push_back(response);
+  }
+
+  // return this raw HTTP response for every request, nullptr to stop. The pointer is NOT copied
+  void setResponse(const char* response) {
+    repeated = response;
+  }
+
+  // return at most this many bytes per read() and available(), to simulate network packets
+  void setReadChunkSize(size_t size) {
+    chunkSize = size > 0 ? size : 1;
+  }
+
+  // close the connection after every response, like a proxy that does not keep connections alive
+  void setCloseAfterResponse(bool close) {
+    closeAfterResponse = close;
+  }
+
+  // do not answer the next request and report the connection as closed, like a proxy that closed
+  // an idle keep-alive connection before the request arrived
+  void dropNextRequest() {
+    dropRequest = true;
+  }
+
+  // make the next connect() fail
+  void failNextConnect() {
+    failConnect = true;
+  }
+
+  // the last complete request sent by the library
+  const std::string& lastRequest() const {
+    return previousRequest;
+  }
+
+  unsigned long connects = 0;
+  unsigned long writes = 0;
+  unsigned long reads = 0;
+
+  using Print::write;
+  using Stream::readBytes;
+
+  int connect(IPAddress, uint16_t) override {
+    return open();
+  }
+
+  int connect(const char*, uint16_t) override {
+    return open();
+  }
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (!isOpen) {
+      return 0;
+    }
+    writes++;
+    request.append(reinterpret_cast<const char*>(buffer), size);
+    requestPending = true;
+    return size;
+  }
+
+  int available() override {
+    startResponse();
+    size_t remaining = responseLength - position;
+    return static_cast<int>(remaining < chunkSize ? remaining : chunkSize);
+  }
+
+  int read() override {
+    if (available() <= 0) {
+      return -1;
+    }
+    reads++;
+    return static_cast<unsigned char>(response[position++]);
+  }
+
+  int read(uint8_t* buffer, size_t size) override {
+    int n = available();
+    if (n <= 0) {
+      return -1;
+    }
+    if (static_cast<size_t>(n) > size) {
+      n = size;
+    }
+    reads++;
+    memcpy(buffer, response + position, n);
+    position += n;
+    return n;
+  }
+
+  int peek() override {
+    if (available() <= 0) {
+      return -1;
+    }
+    return static_cast<unsigned char>(response[position]);
+  }
+
+  void flush() override {}
+
+  void stop() override {
+    isOpen = false;
+    response = nullptr;
+    responseLength = 0;
+    position = 0;
+    request.clear();
+    requestPending = false;
+  }
+
+  uint8_t connected() override {
+    if (!isOpen || peerClosed) {
+      return 0;
+    }
+    // after the response has been read completely the proxy closes the connection
+    return !(closeAfterResponse && response != nullptr && position == responseLength);
+  }
+
+  operator bool() override {
+    return isOpen;
+  }
+
+private:
+  int open() {
+    if (failConnect) {
+      failConnect = false;
+      return 0;
+    }
+    stop();
+    isOpen = true;
+    peerClosed = false;
+    connects++;
+    return 1;
+  }
+
+  // the request has been sent completely when the library starts reading, load the next response
+  void startResponse() {
+    if (!isOpen || !requestPending || position < responseLength) {
+      return;
+    }
+    requestPending = false;
+    previousRequest.swap(request);
+    request.clear();
+    if (dropRequest) {
+      dropRequest = false;
+      peerClosed = true;
+      response = nullptr;
+      responseLength = 0;
+      position = 0;
+      return;
+    }
+    if (!queued.empty()) {
+      response = queued.front();
+      queued.pop_front();
+    } else {
+      response = repeated;
+    }
+    responseLength = response != nullptr ? strlen(response) : 0;
+    position = 0;
+  }
+
+  std::deque<const char*> queued;
+  const char* repeated = nullptr;
+  const char* response = nullptr;
+  size_t responseLength = 0;
+  size_t position = 0;
+  size_t chunkSize = 1460;
+  bool closeAfterResponse = false;
+  bool failConnect = false;
+  bool dropRequest = false;
+  bool peerClosed = false;
+  bool isOpen = false;
+  bool requestPending = false;
+  std::string request;
+  std::string previousRequest;
+};
+
+#endif /* NEON_HOST_WIFICLIENT_H */
@@ -0,0 +1,299 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESAGGREGATOR_H
+#define NEONPOSTGRESAGGREGATOR_H
+#include <Arduino.h>
+#include <cstring>
+
+/**
+ * @brief Statistics of one closed window of a series, see NeonPostgresAggregator::emitDue()
+ *
+ * @tparam QuantileBins number of bins of the quantile sketch, 0 without quantiles
+ */
+template <size_t QuantileBins>
+struct NeonWindow {
+  const char* series;
+  // millis() of the first sample and of the end of the window
+  unsigned long start;
+  unsigned long end;
+  unsigned long count;
+  float min;
+  float max;
+  float last;
+  double sum;
+  // range covered by the bins, values outside are counted in the first or last bin
+  float low;
+  float high;
+  uint16_t bins[QuantileBins > 0 ? QuantileBins : 1];
+
+  float mean() const {
+    return count > 0 ? static_cast<float>(sum / count) : 0;
+  }
+
+  /**
+     * @brief Approximate quantile from the bins, interpolated linearly within a bin and limited to [min, max].
+     *        The error is at most the width of a bin, (high - low) / QuantileBins.
+     *
+     * @param q quantile between 0 and 1, for example 0.5 for the median
+     */
+  float quantile(float q) const {
+    if (QuantileBins == 0 || count == 0 || !(high > low)) {
+      return mean();
+    }
+    // the bins saturate at 65535 samples, count from the bins instead of count
+    unsigned long total = 0;
+    for (size_t i = 0; i < QuantileBins; i++) {
+      total += bins[i];
+    }
+    float wanted = q * total;
+    float width = (high - low) / QuantileBins;
+    unsigned long below = 0;
+    for (size_t i = 0; i < QuantileBins; i++) {
+      if (bins[i] > 0 && below + bins[i] >= wanted) {
+        float value = low + width * (i + (wanted - below) / bins[i]);
+        return value < min ? min : (value > max ? max : value);
+      }
+      below += bins[i];
+    }
+    return max;
+  }
+};
+
+/**
+ * @brief Reduces samples to one row per series and time window before they are sent, for example
+ *        10 samples per second to the count, minimum, maximum, mean and last value of every minute.
+ *        Each series keeps only its running statistics and, with QuantileBins > 0, a histogram of
+ *        fixed bins for approximate quantiles, so memory does not grow with the number of samples.
+ *        A window starts with its first sample and closes windowMillis later, closed windows are
+ *        passed to a NeonPostgresBatchInsert (or NeonPostgresOutbox) or to your own function.
+ * @example
+ * ```cpp
+ * const char* columns[] = { "sensor_name", "samples", "min_value", "max_value", "avg_value", "last_value" };
+ * const char* types[] = { "text", "int", "float", "float", "float", "float" };
+ * NeonPostgresBatchInsert<10, 6> batch(sqlClient, "sensor_minutes", columns, types);
+ * NeonPostgresAggregator<2> aggregator(60000);
+ *
+ * void setup() {
+ *   ...
+ *   aggregator.addSeries("temperature");
+ *   aggregator.addSeries("humidity");
+ * }
+ *
+ * void loop() {
+ *   aggregator.add(0, readTemperature());
+ *   aggregator.add(1, readHumidity());
+ *   aggregator.appendDueTo(batch);
+ *   batch.flushIfDue();
+ *   delay(100);
+ * }
+ * ```
+ *
+ * @tparam Series maximum number of series
+ * @tparam QuantileBins number of bins of the quantile sketch per series, 0 for no quantiles
+ */
+template <size_t Series, size_t QuantileBins = 0>
+class NeonPostgresAggregator {
+public:
+  typedef NeonWindow<QuantileBins> Window;
+
+  /**
+     * @param windowMillis length of a window in milliseconds
+     */
+  NeonPostgresAggregator(unsigned long windowMillis)
+    : windowMillis(windowMillis) {}
+
+  /**
+     * @brief Add a series.
+     *
+     * @param name name of the series, the first column of the rows appended by appendDueTo().
+     *             This pointer must be valid for the complete lifetime of the aggregator, it is NOT copied
+     * @param low lowest value resolved by the quantile sketch
+     * @param high highest value resolved by the quantile sketch
+     *
+     * @return index of the series for add(), -1 if Series series have been added already
+     */
+  int addSeries(const char* name, float low = 0, float high = 0) {
+    if (seriesCount == Series) {
+      return -1;
+    }
+    Window& window = windows[seriesCount];
+    window.series = name;
+    window.low = low;
+    window.high = high;
+    reset(window);
+    return seriesCount++;
+  }
+
+  /**
+     * @brief Add a sample to the open window of a series. The sample starts a new window if there is none.
+     *        A window that is due but has not been accepted by the sink yet keeps collecting samples.
+     *
+     * @return false if there is no such series
+     */
+  bool add(int series, float value) {
+    if (series < 0 || static_cast<size_t>(series) >= seriesCount) {
+      return false;
+    }
+    Window& window = windows[series];
+    if (window.count == 0) {
+      window.start = millis();
+      window.min = value;
+      window.max = value;
+    } else {
+      window.min = value < window.min ? value : window.min;
+      window.max = value > window.max ? value : window.max;
+    }
+    window.count++;
+    window.sum += value;
+    window.last = value;
+    addToBin(window, value);
+    return true;
+  }
+
+  // add a sample to the series with this name
+  bool add(const char* series, float value) {
+    for (size_t i = 0; i < seriesCount; i++) {
+      if (strcmp(windows[i].series, series) == 0) {
+        return add(static_cast<int>(i), value);
+      }
+    }
+    return false;
+  }
+
+  // true if the window of at least one series is closed
+  bool due() const {
+    for (size_t i = 0; i < seriesCount; i++) {
+      if (isDue(windows[i])) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+     * @brief Pass every closed window to emit, a function or lambda bool(const NeonWindow<QuantileBins>&),
+     *        and start the next window of the series. A window for which emit returns false stays open
+     *        and is passed again with the next call.
+     * @example
+     * ```cpp
+     * aggregator.emitDue([](const NeonWindow<0>& window) {
+     *   return batch.append(window.series, window.count, window.mean());
+     * });
+     * ```
+     *
+     * @return number of windows emitted
+     */
+  template <typename Emit>
+  size_t emitDue(Emit emit) {
+    return emitWindows(emit, false);
+  }
+
+  // like emitDue() but for all windows with samples, for example before deep sleep
+  template <typename Emit>
+  size_t emitAll(Emit emit) {
+    return emitWindows(emit, true);
+  }
+
+  /**
+     * @brief Append one row per closed window to sink, a NeonPostgresBatchInsert or NeonPostgresOutbox with
+     *        the columns series name, count, min, max, mean and last value, followed by the median and the
+     *        95th percentile with QuantileBins > 0.
+     *        The row has no time, give the table a timestamp column with DEFAULT now() or use emitDue()
+     *        to add the time of the window yourself.
+     *
+     * @return number of rows appended
+     */
+  template <typename Sink>
+  size_t appendDueTo(Sink& sink) {
+    return emitWindows(SinkAppender<Sink>(sink), false);
+  }
+
+  // like appendDueTo() but for all windows with samples, for example before deep sleep
+  template <typename Sink>
+  size_t appendAllTo(Sink& sink) {
+    return emitWindows(SinkAppender<Sink>(sink), true);
+  }
+
+  // statistics of the open window of a series
+  const Window& getWindow(size_t series) const {
+    return windows[series];
+  }
+
+private:
+  template <bool>
+  struct WithQuantiles {};
+
+  // appends the standard row of a window, without and with quantile columns
+  template <typename Sink>
+  struct SinkAppender {
+    SinkAppender(Sink& sink)
+      : sink(sink) {}
+
+    bool operator()(const Window& window) {
+      return append(window, WithQuantiles<(QuantileBins > 0)>());
+    }
+
+    bool append(const Window& window, WithQuantiles<false>) {
+      return sink.append(window.series, window.count, window.min, window.max, window.mean(), window.last);
+    }
+
+    bool append(const Window& window, WithQuantiles<true>) {
+      return sink.append(window.series, window.count, window.min, window.max, window.mean(), window.last,
+                         window.quantile(0.5f), window.quantile(0.95f));
+    }
+
+    Sink& sink;
+  };
+
+  bool isDue(const Window& window) const {
+    return window.count > 0 && millis() - window.start >= windowMillis;
+  }
+
+  template <typename Emit>
+  size_t emitWindows(Emit emit, bool all) {
+    size_t emitted = 0;
+    for (size_t i = 0; i < seriesCount; i++) {
+      Window& window = windows[i];
+      if (window.count == 0 || (!all && !isDue(window))) {
+        continue;
+      }
+      window.end = millis();
+      if (!emit(static_cast<const Window&>(window))) {
+        continue;
+      }
+      reset(window);
+      emitted++;
+    }
+    return emitted;
+  }
+
+  void reset(Window& window) {
+    window.count = 0;
+    window.sum = 0;
+    window.min = 0;
+    window.max = 0;
+    window.last = 0;
+    window.start = 0;
+    window.end = 0;
+    memset(window.bins, 0, sizeof(window.bins));
+  }
+
+  void addToBin(Window& window, float value) {
+    if (QuantileBins == 0 || !(window.high > window.low)) {
+      return;
+    }
+    float position = (value - window.low) / (window.high - window.low) * QuantileBins;
+    size_t bin = position <= 0 ? 0 : (position >= QuantileBins ? QuantileBins - 1 : static_cast<size_t>(position));
+    if (window.bins[bin] < 65535) {
+      window.bins[bin]++;
+    }
+  }
+
+  unsigned long windowMillis;
+  Window windows[Series];
+  size_t seriesCount = 0;
+};
+
+#endif /* NEONPOSTGRESAGGREGATOR_H */
@@ -0,0 +1,277 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESALLOCATOR_H
+#define NEONPOSTGRESALLOCATOR_H
+#include <ArduinoJson.h>
+#include <cstring>
+#include <stdlib.h>
+
+/**
+ * @brief ArduinoJson allocator that uses malloc()/realloc()/free(), the default of
+ *        NeonPostgresOverHTTPProxyClient.
+ */
+class NeonHeapAllocator : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override {
+    return malloc(size);
+  }
+
+  void deallocate(void* ptr) override {
+    free(ptr);
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    return realloc(ptr, new_size);
+  }
+
+  static NeonHeapAllocator* instance() {
+    static NeonHeapAllocator allocator;
+    return &allocator;
+  }
+};
+
+/**
+ * @brief ArduinoJson allocator that forwards to another allocator and counts the bytes in use.
+ *        Every allocation gets a small header with its size, so freed bytes can be counted as well.
+ *        Optionally it enforces a limit, the client uses that for its memory budgets.
+ */
+class NeonTrackingAllocator : public ArduinoJson::Allocator {
+public:
+  NeonTrackingAllocator(ArduinoJson::Allocator* target = NeonHeapAllocator::instance())
+    : target(target) {}
+
+  void* allocate(size_t size) override {
+    if (!allowed(used + size)) {
+      return nullptr;
+    }
+    uint8_t* block = static_cast<uint8_t*>(target->allocate(HeaderSize + size));
+    if (block == nullptr) {
+      return nullptr;
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    add(size);
+    return block + HeaderSize;
+  }
+
+  void deallocate(void* ptr) override {
+    if (ptr == nullptr) {
+      return;
+    }
+    uint8_t* block = static_cast<uint8_t*>(ptr) - HeaderSize;
+    used -= *reinterpret_cast<size_t*>(block);
+    target->deallocate(block);
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    if (ptr == nullptr) {
+      return allocate(new_size);
+    }
+    uint8_t* block = static_cast<uint8_t*>(ptr) - HeaderSize;
+    size_t oldSize = *reinterpret_cast<size_t*>(block);
+    if (new_size > oldSize && !allowed(used - oldSize + new_size)) {
+      return nullptr;
+    }
+    uint8_t* moved = static_cast<uint8_t*>(target->reallocate(block, HeaderSize + new_size));
+    if (moved == nullptr) {
+      return nullptr;
+    }
+    *reinterpret_cast<size_t*>(moved) = new_size;
+    used -= oldSize;
+    add(new_size);
+    return moved + HeaderSize;
+  }
+
+  // the allocator that provides the memory, only change it while nothing is allocated
+  void setTarget(ArduinoJson::Allocator* allocator) {
+    target = allocator;
+  }
+
+  // bytes currently allocated, without the headers
+  size_t getUsed() const {
+    return used;
+  }
+
+  // maximum of getUsed() since construction or resetPeak()
+  size_t getPeak() const {
+    return peak;
+  }
+
+  // also forgets the allocations refused because of the limit
+  void resetPeak() {
+    peak = used;
+    refused = 0;
+  }
+
+  /**
+     * @brief Refuse allocations that would make getUsed() larger than limit, 0 for no limit.
+     *        The JsonDocument then fails with "NoMemory" as if the target had no more memory.
+     */
+  void setLimit(size_t limit) {
+    this->limit = limit;
+  }
+
+  size_t getLimit() const {
+    return limit;
+  }
+
+  // getUsed() the largest allocation refused because of the limit would have resulted in
+  // since construction or resetPeak(), 0 if none was refused
+  size_t getRefused() const {
+    return refused;
+  }
+
+private:
+  static const size_t HeaderSize = 8;
+
+  bool allowed(size_t total) {
+    if (limit == 0 || total <= limit) {
+      return true;
+    }
+    if (total > refused) {
+      refused = total;
+    }
+    return false;
+  }
+
+  void add(size_t size) {
+    used += size;
+    if (used > peak) {
+      peak = used;
+    }
+  }
+
+  ArduinoJson::Allocator* target;
+  size_t used = 0;
+  size_t peak = 0;
+  size_t limit = 0;
+  size_t refused = 0;
+};
+
+/**
+ * @brief ArduinoJson allocator that hands out memory from a fixed-size buffer (a bump allocator).
+ *        Memory freed in the middle of the buffer is not reused, instead the buffer is reset as soon
+ *        as everything allocated from it has been freed. Give each result document of
+ *        NeonPostgresOverHTTPProxyClient its own arena: the document is cleared before the response of its
+ *        next successful request is parsed, which resets the arena, so memory use is deterministic,
+ *        no malloc() is called while a result is parsed and the heap cannot fragment.
+ *        An arena shared by two documents is only reset while both are empty, until then it only grows.
+ *        Size it for the largest result you expect including some overhead. A result that does not fit
+ *        fails with "NoMemory".
+ * @example
+ * ```cpp
+ * NeonArenaAllocator<8192> resultArena;
+ * NeonArenaAllocator<4096> transactionArena;
+ * NeonPostgresOverHTTPProxyClient sqlClient(client, DATABASE_URL, NEON_PROXY, 443,
+ *                                           NeonHeapAllocator::instance(), &resultArena, &transactionArena);
+ * ```
+ *
+ * @tparam Size size of the buffer in bytes
+ */
+template <size_t Size>
+class NeonArenaAllocator : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override {
+    size_t needed = HeaderSize + align(size);
+    if (needed > Size - used) {
+      return nullptr;
+    }
+    uint8_t* block = buffer + used;
+    *reinterpret_cast<size_t*>(block) = size;
+    used += needed;
+    live++;
+    if (used > peak) {
+      peak = used;
+    }
+    return block + HeaderSize;
+  }
+
+  void deallocate(void* ptr) override {
+    if (ptr == nullptr) {
+      return;
+    }
+    if (isLast(ptr)) {
+      used -= HeaderSize + align(blockSize(ptr));
+    }
+    if (--live == 0) {
+      used = 0;
+    }
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    if (ptr == nullptr) {
+      return allocate(new_size);
+    }
+    size_t oldSize = blockSize(ptr);
+    if (isLast(ptr)) {
+      // grow or shrink in place
+      size_t offset = static_cast<uint8_t*>(ptr) - buffer;
+      if (align(new_size) > Size - offset) {
+        return nullptr;
+      }
+      used = offset + align(new_size);
+      *reinterpret_cast<size_t*>(static_cast<uint8_t*>(ptr) - HeaderSize) = new_size;
+      if (used > peak) {
+        peak = used;
+      }
+      return ptr;
+    }
+    if (new_size <= oldSize) {
+      return ptr;
+    }
+    void* moved = allocate(new_size);
+    if (moved == nullptr) {
+      return nullptr;
+    }
+    memcpy(moved, ptr, oldSize);
+    deallocate(ptr);
+    return moved;
+  }
+
+  /**
+     * @brief Forget all allocations. Only call this when no JsonDocument uses memory from the arena,
+     *        the arena resets itself when the last allocation is freed.
+     */
+  void reset() {
+    used = 0;
+    live = 0;
+  }
+
+  // bytes currently in use, including allocations that have been freed but not yet reclaimed
+  size_t getUsed() const {
+    return used;
+  }
+
+  // maximum of getUsed() since construction
+  size_t getPeak() const {
+    return peak;
+  }
+
+  size_t getCapacity() const {
+    return Size;
+  }
+
+private:
+  static const size_t Alignment = 8;
+  static const size_t HeaderSize = Alignment;
+
+  static size_t align(size_t size) {
+    return (size + Alignment - 1) & ~(Alignment - 1);
+  }
+
+  static size_t blockSize(void* ptr) {
+    return *reinterpret_cast<size_t*>(static_cast<uint8_t*>(ptr) - HeaderSize);
+  }
+
+  bool isLast(void* ptr) const {
+    return static_cast<uint8_t*>(ptr) + align(blockSize(ptr)) == buffer + used;
+  }
+
+  alignas(Alignment) uint8_t buffer[Size];
+  size_t used = 0;
+  size_t peak = 0;
+  size_t live = 0;
+};
+
+#endif /* NEONPOSTGRESALLOCATOR_H */
@@ -0,0 +1,461 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESBATCHINSERT_H
+#define NEONPOSTGRESBATCHINSERT_H
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "NeonPostgresOverHTTP.h"
+#include "NeonPostgresValue.h"
+
+/**
+ * @brief Result of flushing a batch of rows, see NeonPostgresBatchInsert::flush()
+ */
+struct NeonBatchResult {
+  // nullptr on success, error message in case of failure
+  const char* errorMessage;
+  // number of buffered rows sent in this batch, they are removed from the buffer on success
+  size_t rows;
+  // number of rows inserted as reported by the database
+  int rowsAffected;
+  // number of rows removed from the buffer without being inserted because the database rejected their values,
+  // a data exception or constraint violation (NeonSqlErrorDetails::isDataError()) fails again with every retry
+  size_t dropped;
+};
+
+/**
+ * @brief Buffers rows for one table on the microcontroller and inserts them with a single
+ *        request instead of one request per row.
+ *        Rows are kept in a fixed-capacity ring buffer, no heap memory is used per row.
+ *        A batch is sent as one multi-row INSERT ... VALUES statement, as one INSERT ... SELECT
+ *        from unnest() with one array parameter per column, or as one transaction
+ *        with one INSERT per row, when flush() is called or - with flushIfDue() - when the number
+ *        of rows, the payload size or the age of the oldest row reaches its threshold.
+ *
+ *        The batch uses the statement of the client (setQuery()/getParams()) or its transaction
+ *        (startTransaction()), set them again after a flush if you also use them directly.
+ * @example
+ * ```cpp
+ * const char* columns[] = { "sensor_name", "sensor_value" };
+ * const char* types[] = { "text", "float" };
+ * NeonPostgresBatchInsert<20, 2> batch(sqlClient, "sensorvalues", columns, types);
+ * ...
+ * void loop() {
+ *   batch.append("temperature", temperature);
+ *   NeonBatchResult result = batch.flushIfDue();
+ *   if (result.errorMessage != nullptr) {
+ *     Serial.println(result.errorMessage);
+ *   }
+ * }
+ * ```
+ *
+ * @tparam MaxRows capacity of the buffer in rows
+ * @tparam Columns number of columns in a row
+ * @tparam RowTextBytes buffer size per row for the text values of all columns including their terminating 0
+ * @tparam Client the database client type, a BasicNeonClient
+ */
+template <size_t MaxRows, size_t Columns, size_t RowTextBytes = 48, typename Client = NeonPostgresOverHTTPProxyClient>
+class NeonPostgresBatchInsert {
+public:
+  enum FlushMode {
+    // one INSERT INTO table (columns) VALUES (...), (...), ... statement
+    MultiRowValues,
+    // one transaction with one INSERT statement per row
+    Transaction,
+    // one INSERT INTO table (columns) SELECT * FROM unnest($1::type[], $2::type[]) statement, the values of each
+    // column are sent as one Postgres array literal. The SQL text does not depend on the number of rows and
+    // the request size is nearly proportional to the data. Float values are sent with the fewest digits that
+    // read back as the same value, NaN and infinity as NULL
+    Unnest
+  };
+
+  /**
+     * @brief Constructs a batch for a table.
+     *
+     * @param client the database client used to send the batches
+     * @param table name of the table, used as is in the SQL text
+     * @param columns names of the columns, used as is in the SQL text
+     * @param types Postgres types of the columns used to cast the parameters, for example "text" or "float",
+     *              nullptr for no casts. Unnest needs the array types, nullptr is sent as text[]
+     * @param mode how a batch is sent
+     *
+     * All pointers must be valid for the complete lifetime of the batch, they are NOT copied
+     */
+  NeonPostgresBatchInsert(Client& client, const char* table, const char* const (&columns)[Columns],
+                          const char* const (&types)[Columns], FlushMode mode = MultiRowValues)
+    : client(client), table(table), columns(columns), types(types), mode(mode) {}
+
+  /**
+     * @brief Set when flushIfDue() sends a batch. A threshold of 0 is ignored.
+     *
+     * @param rows flush when this many rows are buffered, defaults to MaxRows
+     * @param bytes flush when the Json payload of the buffered rows reaches approximately this many bytes
+     * @param age flush when the oldest buffered row is older than this many milliseconds
+     */
+  void setFlushThresholds(size_t rows, size_t bytes = 0, unsigned long age = 0) {
+    maxRows = rows;
+    maxBytes = bytes;
+    maxAge = age;
+  }
+
+  /**
+     * @brief Add a row to the buffer. Pass one value per column, in the order of the columns.
+     *        Supported types are bool, integers up to 64 bits, float, double, const char* and nullptr for NULL.
+     *        Text values are copied.
+     *
+     * @return false if the buffer is full or the text values do not fit into RowTextBytes
+     */
+  template <typename... Values>
+  bool append(Values... values) {
+    static_assert(sizeof...(Values) == Columns, "append() needs one value per column");
+    if (count == MaxRows) {
+      return false;
+    }
+    Row& row = rows[(head + count) % MaxRows];
+    row.textUsed = 0;
+    row.bytes = 0;
+    if (!storeValues(row, 0, values...)) {
+      return false;
+    }
+    row.time = millis();
+    count++;
+    pendingBytes += row.bytes;
+    return true;
+  }
+
+  // number of rows buffered
+  size_t size() const {
+    return count;
+  }
+
+  bool full() const {
+    return count == MaxRows;
+  }
+
+  // remove all buffered rows without sending them
+  void discard() {
+    head = (head + count) % MaxRows;
+    count = 0;
+    pendingBytes = 0;
+  }
+
+  /**
+     * @brief true if one of the thresholds set with setFlushThresholds() is reached.
+     */
+  bool flushDue() const {
+    if (count == 0) {
+      return false;
+    }
+    return count >= (maxRows > 0 ? maxRows : MaxRows)
+           || (maxBytes > 0 && pendingBytes >= maxBytes)
+           || (maxAge > 0 && millis() - rows[head].time >= maxAge);
+  }
+
+  /**
+     * @brief Send the batch if flushDue().
+     *
+     * @return the result of the batch, rows is 0 if nothing was sent
+     */
+  NeonBatchResult flushIfDue(unsigned long timeout = 20000) {
+    if (!flushDue()) {
+      return NeonBatchResult{ nullptr, 0, 0, 0 };
+    }
+    return flush(timeout);
+  }
+
+  /**
+     * @brief Send all buffered rows as one batch.
+     *        On success the rows are removed from the buffer. If the database rejects their values, for example
+     *        with a constraint violation, the rows are dropped (see NeonBatchResult::dropped). In case of any
+     *        other failure, for example a network error, they are kept and sent again with the next flush.
+     *
+     * @param timeout maximum time in milliseconds to wait for response
+     *
+     * @return the result of the batch
+     */
+  NeonBatchResult flush(unsigned long timeout = 20000) {
+    NeonBatchResult result{ nullptr, count, 0, 0 };
+    if (count == 0) {
+      return result;
+    }
+    sqlRejected = false;
+    if (mode == Transaction) {
+      result.errorMessage = flushTransaction(timeout, result.rowsAffected);
+    } else if (mode == Unnest) {
+      result.errorMessage = flushUnnest(timeout, result.rowsAffected);
+    } else {
+      result.errorMessage = flushMultiRowValues(timeout, result.rowsAffected);
+    }
+    if (sqlRejected) {
+      result.dropped = count;
+    }
+    if (result.errorMessage == nullptr || sqlRejected) {
+      discard();
+    }
+    return result;
+  }
+
+private:
+  struct Row {
+    NeonPostgresValue values[Columns];
+    char text[RowTextBytes];
+    size_t textUsed;
+    size_t bytes;
+    unsigned long time;
+  };
+
+  bool storeValues(Row&, size_t) {
+    return true;
+  }
+
+  template <typename Value, typename... Rest>
+  bool storeValues(Row& row, size_t column, Value value, Rest... rest) {
+    NeonPostgresValue v(value);
+    if (v.type == NeonPostgresValue::Text) {
+      size_t len = strlen(v.textValue) + 1;
+      if (row.textUsed + len > RowTextBytes) {
+        return false;
+      }
+      memcpy(row.text + row.textUsed, v.textValue, len);
+      v.textValue = row.text + row.textUsed;
+      row.textUsed += len;
+    }
+    row.values[column] = v;
+    row.bytes += v.jsonSize() + 8;  // + the parameter marker in the SQL text
+    return storeValues(row, column + 1, rest...);
+  }
+
+  // "INSERT INTO table (c1, c2) VALUES " without the value lists
+  void appendInsertPrefix(String& sql) {
+    appendInsertInto(sql);
+    sql += "VALUES ";
+  }
+
+  // "INSERT INTO table (c1, c2) "
+  void appendInsertInto(String& sql) {
+    sql += "INSERT INTO ";
+    sql += table;
+    sql += " (";
+    for (size_t c = 0; c < Columns; c++) {
+      if (c > 0) {
+        sql += ", ";
+      }
+      sql += columns[c];
+    }
+    sql += ") ";
+  }
+
+  // "($n::type, $n+1::type)" with parameter markers starting at firstParam
+  void appendValueList(String& sql, size_t firstParam) {
+    sql += '(';
+    for (size_t c = 0; c < Columns; c++) {
+      if (c > 0) {
+        sql += ", ";
+      }
+      sql += '$';
+      sql += static_cast<unsigned long>(firstParam + c);
+      if (types[c] != nullptr) {
+        sql += "::";
+        sql += types[c];
+      }
+    }
+    sql += ')';
+  }
+
+  const char* flushMultiRowValues(unsigned long timeout, int& rowsAffected) {
+    // the statement text only depends on the number of rows, only build it when that changes
+    if (sqlRows != count) {
+      sql = "";
+      appendInsertPrefix(sql);
+      for (size_t r = 0; r < count; r++) {
+        if (r > 0) {
+          sql += ", ";
+        }
+        appendValueList(sql, 1 + r * Columns);
+      }
+      sqlRows = count;
+    }
+    client.setQuery(sql.c_str());
+    JsonArray params = client.getParams();
+    params.clear();
+    for (size_t r = 0; r < count; r++) {
+      const Row& row = rows[(head + r) % MaxRows];
+      for (size_t c = 0; c < Columns; c++) {
+        if (!row.values[c].addTo(params)) {
+          return "batch does not fit into memory";
+        }
+      }
+    }
+    const char* errorMessage = client.execute(timeout);
+    if (errorMessage == nullptr) {
+      rowsAffected = client.getRowCount();
+    }
+    sqlRejected = rejected(errorMessage);
+    return errorMessage;
+  }
+
+  // appends to a String, used to print the numbers of an array literal without a temporary String
+  // Postgres array literal of one column, for example {"temperature","humidity",NULL} or {21.5,48}
+  void appendArrayLiteral(String& literal, size_t column) {
+    literal = "";
+    literal += '{';
+    for (size_t r = 0; r < count; r++) {
+      const NeonPostgresValue& v = rows[(head + r) % MaxRows].values[column];
+      if (r > 0) {
+        literal += ',';
+      }
+      switch (v.type) {
+        case NeonPostgresValue::Bool:
+          literal += v.boolValue ? 't' : 'f';
+          break;
+        case NeonPostgresValue::Int:
+        case NeonPostgresValue::Unsigned: {
+          char text[21];
+          literal += v.formatInteger(text);
+          break;
+        }
+        case NeonPostgresValue::Float:
+          appendFloat(literal, v.floatValue);
+          break;
+        case NeonPostgresValue::Text:
+          literal += '"';
+          for (const char* t = v.textValue; *t != 0; t++) {
+            if (*t == '"' || *t == '\\') {
+              literal += '\\';
+            }
+            literal += *t;
+          }
+          literal += '"';
+          break;
+        default:
+          literal += "NULL";
+          break;
+      }
+    }
+    literal += '}';
+  }
+
+  // shortest text that reads back as the same value, like the JSON parameters, NULL for NaN and infinity
+  // which a float8 array element cannot hold
+  static void appendFloat(String& literal, double value) {
+    if (!isfinite(value)) {
+      literal += "NULL";
+      return;
+    }
+    // a value from a float needs at most 9 significant digits, a double 17
+    bool fromFloat = static_cast<double>(static_cast<float>(value)) == value;
+    char text[32];
+    for (int digits = fromFloat ? 6 : 15;; digits++) {
+      snprintf(text, sizeof(text), "%.*g", digits, value);
+      bool same = fromFloat ? strtof(text, nullptr) == static_cast<float>(value) : strtod(text, nullptr) == value;
+      if (same || digits == 17) {
+        break;
+      }
+    }
+    literal += text;
+  }
+
+  const char* flushUnnest(unsigned long timeout, int& rowsAffected) {
+    // the statement text does not depend on the number of rows
+    if (sql.length() == 0) {
+      appendInsertInto(sql);
+      sql += "SELECT * FROM unnest(";
+      for (size_t c = 0; c < Columns; c++) {
+        if (c > 0) {
+          sql += ", ";
+        }
+        sql += '$';
+        sql += static_cast<unsigned long>(c + 1);
+        sql += "::";
+        sql += types[c] != nullptr ? types[c] : "text";
+        sql += "[]";
+      }
+      sql += ')';
+    }
+    client.setQuery(sql.c_str());
+    JsonArray params = client.getParams();
+    params.clear();
+    String literal;
+    for (size_t c = 0; c < Columns; c++) {
+      // ArduinoJson copies the literal into the statement
+      appendArrayLiteral(literal, c);
+      if (!params.add(literal.c_str())) {
+        return "batch does not fit into memory";
+      }
+    }
+    const char* errorMessage = client.execute(timeout);
+    if (errorMessage == nullptr) {
+      rowsAffected = client.getRowCount();
+    }
+    sqlRejected = rejected(errorMessage);
+    return errorMessage;
+  }
+
+  template <bool>
+  struct WithTransactions {};
+
+  const char* flushTransaction(unsigned long timeout, int& rowsAffected) {
+    return flushTransaction(timeout, rowsAffected, WithTransactions<Client::FeatureSet::Transactions>());
+  }
+
+  const char* flushTransaction(unsigned long, int&, WithTransactions<false>) {
+    return "Transaction mode needs Features::Transactions";
+  }
+
+  const char* flushTransaction(unsigned long timeout, int& rowsAffected, WithTransactions<true>) {
+    if (sqlRows != 1) {
+      sql = "";
+      appendInsertPrefix(sql);
+      appendValueList(sql, 1);
+      sqlRows = 1;
+    }
+    client.startTransaction();
+    for (size_t r = 0; r < count; r++) {
+      const Row& row = rows[(head + r) % MaxRows];
+      client.addQueryToTransaction(sql.c_str());
+      JsonArray params = client.getParamsForTransactionQuery(r);
+      for (size_t c = 0; c < Columns; c++) {
+        if (!row.values[c].addTo(params)) {
+          return "batch does not fit into memory";
+        }
+      }
+    }
+    const char* errorMessage = client.executeTransaction(timeout);
+    if (errorMessage == nullptr) {
+      for (size_t r = 0; r < count; r++) {
+        rowsAffected += client.getRowCountForTransactionQuery(r);
+      }
+    }
+    sqlRejected = rejected(errorMessage);
+    return errorMessage;
+  }
+
+  // the database rejected the values of the batch, a retry fails the same way. Other SQL errors like a missing
+  // table, serialization failures or deadlocks keep the rows
+  bool rejected(const char* errorMessage) {
+    const NeonSqlErrorDetails* sqlError = client.getSqlError();
+    return errorMessage != nullptr && sqlError != nullptr && sqlError->isDataError();
+  }
+
+  Client& client;
+  const char* table;
+  const char* const* columns;
+  const char* const* types;
+  const FlushMode mode;
+  Row rows[MaxRows];
+  size_t head = 0;
+  size_t count = 0;
+  size_t pendingBytes = 0;
+  size_t maxRows = 0;
+  size_t maxBytes = 0;
+  unsigned long maxAge = 0;
+  // SQL text of the last batch and the number of rows it was built for
+  String sql;
+  size_t sqlRows = 0;
+  // the last flush was rejected by the database
+  bool sqlRejected = false;
+};
+
+#endif /* NEONPOSTGRESBATCHINSERT_H */
@@ -0,0 +1,648 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESOUTBOX_H
+#define NEONPOSTGRESOUTBOX_H
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <time.h>
+#include <esp_random.h>
+#include <LittleFS.h>
+#include "NeonPostgresOverHTTP.h"
+#include "NeonPostgresBatchInsert.h"
+#include "NeonPostgresValue.h"
+
+/**
+ * @brief Memory of a NeonPostgresOutbox that survives deep sleep. Declare it as a global RTC_DATA_ATTR
+ *        variable without initializer, it must not be initialized again when the board wakes up:
+ * ```cpp
+ * RTC_DATA_ATTR NeonOutboxStorage<2048> outboxStorage;
+ * ```
+ *
+ * @tparam Bytes size of the row buffer in bytes
+ */
+template <size_t Bytes>
+struct NeonOutboxStorage {
+  uint32_t magic;
+  // random value chosen at the first start, makes the dedup keys unique across power loss
+  uint32_t bootId;
+  // number of rows appended since the first start
+  uint32_t counter;
+  // rows and bytes in data
+  uint32_t rows;
+  uint32_t used;
+  // rows in the spill file and the offset of the first row that has not been sent yet
+  uint32_t fileRows;
+  uint32_t fileOffset;
+  // time() when the oldest pending row was appended
+  uint32_t oldestTime;
+  uint8_t data[Bytes];
+};
+
+/**
+ * @brief Store-and-forward buffer for battery powered ESP32 boards that sleep between samples.
+ *        Rows are appended in a compact binary encoding to memory that survives deep sleep (RTC memory),
+ *        and spill to a file on LittleFS when that is full. Wifi and TLS only need to come up when
+ *        drainDue() says so, then drain() sends all pending rows in transactions of up to
+ *        MaxRowsPerTransaction rows.
+ *
+ *        Delivery is at-least-once: rows are only removed after their transaction succeeded. Every row
+ *        carries a unique 64-bit dedup key in dedupColumn and is inserted with ON CONFLICT DO NOTHING,
+ *        so rows sent again after a failure in the middle of drain() are not stored twice.
+ *        The table needs a unique constraint or primary key on dedupColumn.
+ * @example
+ * ```cpp
+ * // CREATE TABLE sensorvalues (dedup_key bigint PRIMARY KEY, sensor_name text, sensor_value float,
+ * //                            measure_time timestamptz DEFAULT now())
+ * RTC_DATA_ATTR NeonOutboxStorage<2048> outboxStorage;
+ * const char* columns[] = { "sensor_name", "sensor_value" };
+ * const char* types[] = { "text", "float" };
+ * NeonPostgresOutbox<2, 2048> outbox(sqlClient, outboxStorage, "sensorvalues", "dedup_key", columns, types, "/outbox.bin");
+ *
+ * void setup() {
+ *   outbox.begin();
+ *   outbox.setDrainThresholds(50, 0, 3600);
+ *   outbox.append("temperature", readTemperature());
+ *   if (outbox.drainDue()) {
+ *     connectWiFi();
+ *     NeonBatchResult result = outbox.drain();
+ *   }
+ *   esp_deep_sleep(60e6);
+ * }
+ * ```
+ *
+ * @tparam Columns number of columns of a row, without the dedup key
+ * @tparam Bytes size of the row buffer in the NeonOutboxStorage
+ * @tparam MaxRowsPerTransaction maximum number of rows sent with one request
+ * @tparam Client the database client type, a BasicNeonClient with Features::Transactions
+ */
+template <size_t Columns, size_t Bytes, size_t MaxRowsPerTransaction = 16, typename Client = NeonPostgresOverHTTPProxyClient>
+class NeonPostgresOutbox {
+public:
+  /**
+     * @brief Constructs an outbox for one table.
+     *
+     * @param client the database client used to send the rows
+     * @param storage memory for the rows, declared RTC_DATA_ATTR
+     * @param table name of the table, used as is in the SQL text
+     * @param dedupColumn name of the bigint column for the dedup key, it must be unique
+     * @param columns names of the columns, used as is in the SQL text
+     * @param types Postgres types of the columns used to cast the parameters, nullptr for no casts
+     * @param spillPath path of the file on LittleFS for rows that do not fit into storage, nullptr to not spill
+     *
+     * All pointers must be valid for the complete lifetime of the outbox, they are NOT copied
+     */
+  NeonPostgresOutbox(Client& client, NeonOutboxStorage<Bytes>& storage, const char* table,
+                     const char* dedupColumn, const char* const (&columns)[Columns], const char* const (&types)[Columns],
+                     const char* spillPath = nullptr)
+    : client(client), storage(storage), table(table), dedupColumn(dedupColumn), columns(columns), types(types),
+      spillPath(spillPath) {}
+
+  /**
+     * @brief Call once in setup(). Keeps the rows of the previous wake-ups, initializes the storage after power loss.
+     *        When a spill path is set LittleFS is mounted here.
+     */
+  void begin() {
+    if (spillPath != nullptr) {
+      LittleFS.begin(true);
+    }
+    if (storage.magic == Magic) {
+      return;
+    }
+    // first start or power loss: RTC memory is lost, rows in the spill file are sent again from its beginning
+    memset(&storage, 0, sizeof(storage));
+    storage.magic = Magic;
+    storage.bootId = esp_random() & 0x7fffffff;
+    storage.oldestTime = now();
+    uint32_t fileBytes = 0;
+    storage.fileRows = countFileRows(fileBytes);
+    if (fileBytes < fileSize()) {
+      // power loss during spill() left a partial record, later spills must not append after it
+      corruptRecords++;
+      truncateFile(fileBytes);
+    }
+  }
+
+  /**
+     * @brief Set when drainDue() returns true. A threshold of 0 is ignored.
+     *
+     * @param rows drain when this many rows are pending
+     * @param bytes drain when the rows in RTC memory use this many bytes, 0 to drain when the next row of the
+     *        average size of the rows in RTC memory would not fit.
+     *        Rows that spilled to the file are always due.
+     * @param age drain when the oldest pending row is older than this many seconds
+     */
+  void setDrainThresholds(uint32_t rows, uint32_t bytes = 0, uint32_t age = 0) {
+    maxRows = rows;
+    maxBytes = bytes;
+    maxAge = age;
+  }
+
+  /**
+     * @brief Add a row. Pass one value per column, in the order of the columns.
+     *        Supported types are bool, integers up to 64 bits, float, double, const char* (up to 255 bytes) and nullptr for NULL.
+     *
+     * @return false if the row is larger than Bytes, or does not fit and cannot be spilled to the file
+     */
+  template <typename... Values>
+  bool append(Values... values) {
+    static_assert(sizeof...(Values) == Columns, "append() needs one value per column");
+    NeonPostgresValue row[Columns] = { NeonPostgresValue(values)... };
+    uint8_t record[MaxRecordBytes];
+    uint64_t key = (static_cast<uint64_t>(storage.bootId) << 32) | storage.counter;
+    size_t length = encode(record, key, row);
+    if (length == 0 || length > Bytes) {
+      return false;
+    }
+    if (storage.used + length > Bytes && !spill()) {
+      return false;
+    }
+    memcpy(storage.data + storage.used, record, length);
+    storage.used += length;
+    if (pending() == 0) {
+      storage.oldestTime = now();
+    }
+    storage.rows++;
+    storage.counter++;
+    return true;
+  }
+
+  // remove all pending rows without sending them, including the spill file
+  void discard() {
+    storage.rows = 0;
+    storage.used = 0;
+    storage.fileRows = 0;
+    storage.fileOffset = 0;
+    if (spillPath != nullptr) {
+      LittleFS.remove(spillPath);
+    }
+    storage.oldestTime = now();
+  }
+
+  // number of rows that have not been sent yet
+  uint32_t pending() const {
+    return storage.rows + storage.fileRows;
+  }
+
+  /**
+     * @brief Number of corrupted or truncated records dropped since begin(), by begin() or drain().
+     *        Their rows are lost, the rows after them are still sent.
+     */
+  uint32_t getCorruptRecords() const {
+    return corruptRecords;
+  }
+
+  /**
+     * @brief true if one of the thresholds set with setDrainThresholds() is reached.
+     */
+  bool drainDue() const {
+    if (pending() == 0) {
+      return false;
+    }
+    return (maxRows > 0 && pending() >= maxRows)
+           || (maxBytes > 0 ? storage.used >= maxBytes : storage.used + averageRecordBytes() > Bytes) || storage.fileRows > 0
+           || (maxAge > 0 && now() - storage.oldestTime >= maxAge);
+  }
+
+  /**
+     * @brief Send all pending rows, oldest first, in transactions of up to MaxRowsPerTransaction rows.
+     *        Stops at the first failure, the rows of the failed transaction stay in the outbox.
+     *        If the database rejects the values of a transaction, for example with a constraint violation,
+     *        its rows are sent again one per transaction and the rejected row is dropped
+     *        (see NeonBatchResult::dropped), so one bad row cannot block the outbox.
+     *        Records that were corrupted in RTC memory or in the spill file are dropped the same way,
+     *        see getCorruptRecords().
+     *
+     * @param timeout maximum time in milliseconds to wait for the response of each transaction
+     *
+     * @return the result, rows is the number of rows sent successfully, rowsAffected the number actually
+     *         inserted (rows sent twice are not inserted again)
+     */
+  NeonBatchResult drain(unsigned long timeout = 20000) {
+    NeonBatchResult result{ nullptr, 0, 0, 0 };
+    buildSql();
+    uint32_t limit = MaxRowsPerTransaction;
+    while (pending() > 0) {
+      bool fromFile = storage.fileRows > 0;
+      uint32_t rows = 0;
+      uint32_t bytes = 0;
+      result.errorMessage = fromFile ? addFileRows(rows, bytes, limit) : addRtcRows(rows, bytes, limit);
+      if (result.errorMessage == nullptr && rows == 0) {
+        continue;
+      }
+      bool rejected = false;
+      if (result.errorMessage == nullptr) {
+        result.errorMessage = client.executeTransaction(timeout);
+        const NeonSqlErrorDetails* sqlError = client.getSqlError();
+        rejected = result.errorMessage != nullptr && sqlError != nullptr && sqlError->isDataError();
+      }
+      if (rejected && rows > 1) {
+        // find the rejected row, the rows before it are sent on their own
+        limit = 1;
+        continue;
+      }
+      if (result.errorMessage != nullptr && !rejected) {
+        return result;
+      }
+      if (rejected) {
+        result.dropped += rows;
+      } else {
+        for (uint32_t r = 0; r < rows; r++) {
+          result.rowsAffected += client.getRowCountForTransactionQuery(r);
+        }
+        result.rows += rows;
+      }
+      if (fromFile) {
+        removeFileRows(rows, bytes);
+      } else {
+        removeRtcRows(rows, bytes);
+      }
+      if (rejected) {
+        // the message is only valid until the next request
+        return result;
+      }
+    }
+    storage.oldestTime = now();
+    return result;
+  }
+
+private:
+  static const uint32_t Magic = 0x4e4f4231;  // "NOB1"
+  // a record is at most 255 bytes after its length byte
+  static const size_t MaxRecordBytes = 256;
+
+  enum Encoding : uint8_t {
+    EncodedNull,
+    EncodedFalse,
+    EncodedTrue,
+    EncodedInt,
+    EncodedFloat,
+    EncodedDouble,
+    EncodedText,
+    // added later, so that records written before stay readable
+    EncodedInt64,
+    EncodedUnsigned
+  };
+
+  // rounded up, 0 without rows in RTC memory
+  size_t averageRecordBytes() const {
+    return storage.rows > 0 ? (storage.used + storage.rows - 1) / storage.rows : 0;
+  }
+
+  static uint32_t now() {
+    return static_cast<uint32_t>(time(nullptr));
+  }
+
+  // [length][8 byte key][per value: encoding, payload], returns 0 if the record is too long
+  size_t encode(uint8_t* record, uint64_t key, const NeonPostgresValue (&row)[Columns]) {
+    size_t length = 1;
+    memcpy(record + length, &key, sizeof(key));
+    length += sizeof(key);
+    for (size_t c = 0; c < Columns; c++) {
+      const NeonPostgresValue& v = row[c];
+      size_t needed = 1;
+      bool fitsInt32 = v.type == NeonPostgresValue::Int && v.intValue >= INT32_MIN && v.intValue <= INT32_MAX;
+      if (v.type == NeonPostgresValue::Int || v.type == NeonPostgresValue::Unsigned) {
+        needed += fitsInt32 ? sizeof(int32_t) : sizeof(uint64_t);
+      } else if (v.type == NeonPostgresValue::Float) {
+        needed += static_cast<double>(static_cast<float>(v.floatValue)) == v.floatValue ? sizeof(float) : sizeof(double);
+      } else if (v.type == NeonPostgresValue::Text) {
+        size_t textLength = strlen(v.textValue);
+        if (textLength > 255) {
+          return 0;
+        }
+        needed += 1 + textLength;
+      }
+      if (length + needed > MaxRecordBytes) {
+        return 0;
+      }
+      uint8_t* out = record + length;
+      switch (v.type) {
+        case NeonPostgresValue::Bool:
+          out[0] = v.boolValue ? EncodedTrue : EncodedFalse;
+          break;
+        case NeonPostgresValue::Int:
+          if (fitsInt32) {
+            out[0] = EncodedInt;
+            int32_t i = static_cast<int32_t>(v.intValue);
+            memcpy(out + 1, &i, sizeof(i));
+          } else {
+            out[0] = EncodedInt64;
+            memcpy(out + 1, &v.intValue, sizeof(int64_t));
+          }
+          break;
+        case NeonPostgresValue::Unsigned:
+          out[0] = EncodedUnsigned;
+          memcpy(out + 1, &v.unsignedValue, sizeof(uint64_t));
+          break;
+        case NeonPostgresValue::Float:
+          if (needed == 1 + sizeof(float)) {
+            out[0] = EncodedFloat;
+            float f = v.floatValue;
+            memcpy(out + 1, &f, sizeof(f));
+          } else {
+            out[0] = EncodedDouble;
+            memcpy(out + 1, &v.floatValue, sizeof(double));
+          }
+          break;
+        case NeonPostgresValue::Text:
+          out[0] = EncodedText;
+          out[1] = needed - 2;
+          memcpy(out + 2, v.textValue, needed - 2);
+          break;
+        default:
+          out[0] = EncodedNull;
+          break;
+      }
+      length += needed;
+    }
+    record[0] = length - 1;
+    return length;
+  }
+
+  // true if the record has the length and the encoding of Columns values written by encode()
+  static bool validRecord(const uint8_t* record, size_t length) {
+    size_t pos = 1 + sizeof(uint64_t);
+    for (size_t c = 0; c < Columns; c++) {
+      if (pos >= length) {
+        return false;
+      }
+      uint8_t encoding = record[pos++];
+      if (encoding == EncodedInt) {
+        pos += sizeof(int32_t);
+      } else if (encoding == EncodedFloat) {
+        pos += sizeof(float);
+      } else if (encoding == EncodedDouble || encoding == EncodedInt64 || encoding == EncodedUnsigned) {
+        pos += sizeof(uint64_t);
+      } else if (encoding == EncodedText) {
+        if (pos >= length) {
+          return false;
+        }
+        pos += 1 + record[pos];
+      } else if (encoding != EncodedNull && encoding != EncodedFalse && encoding != EncodedTrue) {
+        return false;
+      }
+    }
+    return pos == length;
+  }
+
+  // add the record as one INSERT to the transaction, returns false if it is malformed or out of memory
+  bool addRecord(const uint8_t* record, size_t length, size_t query) {
+    if (length < 1 + sizeof(uint64_t)) {
+      return false;
+    }
+    client.addQueryToTransaction(sql.c_str());
+    JsonArray params = client.getParamsForTransactionQuery(query);
+    uint64_t key;
+    memcpy(&key, record + 1, sizeof(key));
+    if (!params.add(static_cast<long long>(key))) {
+      return false;
+    }
+    size_t pos = 1 + sizeof(key);
+    char text[256];
+    for (size_t c = 0; c < Columns; c++) {
+      if (pos >= length) {
+        return false;
+      }
+      uint8_t encoding = record[pos++];
+      NeonPostgresValue v;
+      if (encoding == EncodedFalse || encoding == EncodedTrue) {
+        v = NeonPostgresValue(encoding == EncodedTrue);
+      } else if (encoding == EncodedInt && pos + sizeof(int32_t) <= length) {
+        int32_t i;
+        memcpy(&i, record + pos, sizeof(i));
+        pos += sizeof(i);
+        v = NeonPostgresValue(static_cast<long>(i));
+      } else if (encoding == EncodedInt64 && pos + sizeof(int64_t) <= length) {
+        long long i;
+        memcpy(&i, record + pos, sizeof(i));
+        pos += sizeof(i);
+        v = NeonPostgresValue(i);
+      } else if (encoding == EncodedUnsigned && pos + sizeof(uint64_t) <= length) {
+        unsigned long long u;
+        memcpy(&u, record + pos, sizeof(u));
+        pos += sizeof(u);
+        v = NeonPostgresValue(u);
+      } else if (encoding == EncodedFloat && pos + sizeof(float) <= length) {
+        float f;
+        memcpy(&f, record + pos, sizeof(f));
+        pos += sizeof(f);
+        v = NeonPostgresValue(f);
+      } else if (encoding == EncodedDouble && pos + sizeof(double) <= length) {
+        double d;
+        memcpy(&d, record + pos, sizeof(d));
+        pos += sizeof(d);
+        v = NeonPostgresValue(d);
+      } else if (encoding == EncodedText && pos < length && pos + 1 + record[pos] <= length) {
+        size_t textLength = record[pos++];
+        memcpy(text, record + pos, textLength);
+        text[textLength] = 0;
+        pos += textLength;
+        v = NeonPostgresValue(static_cast<const char*>(text));
+      } else if (encoding != EncodedNull) {
+        return false;
+      }
+      // ArduinoJson copies the text into the transaction
+      if (!v.addTo(params)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // a corrupted record ends the transaction before it, and is dropped when it is the first one
+  const char* addRtcRows(uint32_t& rows, uint32_t& bytes, uint32_t limit) {
+    client.startTransaction();
+    while (rows < storage.rows && rows < limit) {
+      const uint8_t* record = storage.data + bytes;
+      size_t length = 1 + record[0];
+      if (bytes + length > storage.used) {
+        if (rows == 0) {
+          // the records cannot be told apart anymore, drop the rest of RTC memory
+          corruptRecords += storage.rows;
+          removeRtcRows(storage.rows, storage.used);
+        }
+        break;
+      }
+      if (!validRecord(record, length)) {
+        if (rows == 0) {
+          corruptRecords++;
+          removeRtcRows(1, length);
+        }
+        break;
+      }
+      if (!addRecord(record, length, rows)) {
+        return "outbox record does not fit into memory";
+      }
+      bytes += length;
+      rows++;
+    }
+    return nullptr;
+  }
+
+  const char* addFileRows(uint32_t& rows, uint32_t& bytes, uint32_t limit) {
+    File file = LittleFS.open(spillPath, "r");
+    if (!file || !file.seek(storage.fileOffset)) {
+      return "cannot read outbox file";
+    }
+    client.startTransaction();
+    uint8_t record[MaxRecordBytes];
+    while (rows < storage.fileRows && rows < limit) {
+      if (file.read(record, 1) != 1) {
+        break;
+      }
+      size_t length = 1 + record[0];
+      if (file.read(record + 1, length - 1) != length - 1) {
+        break;
+      }
+      if (!validRecord(record, length)) {
+        if (rows == 0) {
+          file.close();
+          corruptRecords++;
+          removeFileRows(1, length);
+        }
+        return nullptr;
+      }
+      if (!addRecord(record, length, rows)) {
+        return "outbox record does not fit into memory";
+      }
+      bytes += length;
+      rows++;
+    }
+    if (rows == 0) {
+      // the file ended in or before the next record, the rows recorded in storage are lost
+      file.close();
+      corruptRecords += storage.fileRows;
+      storage.fileRows = 0;
+      storage.fileOffset = 0;
+      LittleFS.remove(spillPath);
+    }
+    return nullptr;
+  }
+
+  void removeRtcRows(uint32_t rows, uint32_t bytes) {
+    memmove(storage.data, storage.data + bytes, storage.used - bytes);
+    storage.used -= bytes;
+    storage.rows -= rows;
+  }
+
+  void removeFileRows(uint32_t rows, uint32_t bytes) {
+    storage.fileOffset += bytes;
+    storage.fileRows = rows < storage.fileRows ? storage.fileRows - rows : 0;
+    if (storage.fileRows == 0) {
+      LittleFS.remove(spillPath);
+      storage.fileOffset = 0;
+    }
+  }
+
+  // move the rows in RTC memory to the end of the spill file
+  bool spill() {
+    if (spillPath == nullptr) {
+      return false;
+    }
+    File file = LittleFS.open(spillPath, "a");
+    if (!file) {
+      return false;
+    }
+    bool written = file.write(storage.data, storage.used) == storage.used;
+    file.close();
+    if (!written) {
+      return false;
+    }
+    storage.fileRows += storage.rows;
+    storage.rows = 0;
+    storage.used = 0;
+    return true;
+  }
+
+  size_t fileSize() {
+    if (spillPath == nullptr || !LittleFS.exists(spillPath)) {
+      return 0;
+    }
+    File file = LittleFS.open(spillPath, "r");
+    return file ? file.size() : 0;
+  }
+
+  // number of complete records in the spill file, bytes is set to their length
+  uint32_t countFileRows(uint32_t& bytes) {
+    bytes = 0;
+    size_t size = fileSize();
+    if (size == 0) {
+      return 0;
+    }
+    File file = LittleFS.open(spillPath, "r");
+    uint32_t rows = 0;
+    uint8_t length;
+    while (file && bytes + 1 <= size && file.read(&length, 1) == 1 && bytes + 1 + length <= size
+           && file.seek(length, SeekCur)) {
+      bytes += 1 + length;
+      rows++;
+    }
+    return rows;
+  }
+
+  // keep only the first bytes of the spill file, copied to a temporary file that replaces it
+  void truncateFile(uint32_t bytes) {
+    String tempPath = spillPath;
+    tempPath += ".tmp";
+    File in = LittleFS.open(spillPath, "r");
+    File out = LittleFS.open(tempPath.c_str(), "w");
+    bool copied = in && out;
+    uint8_t buffer[MaxRecordBytes];
+    for (uint32_t done = 0; copied && done < bytes;) {
+      size_t n = bytes - done < sizeof(buffer) ? bytes - done : sizeof(buffer);
+      copied = in.read(buffer, n) == n && out.write(buffer, n) == n;
+      done += n;
+    }
+    in.close();
+    out.close();
+    if (!copied || !LittleFS.remove(spillPath) || !LittleFS.rename(tempPath.c_str(), spillPath)) {
+      // the records after the partial one are dropped by drain() as corrupted
+      LittleFS.remove(tempPath.c_str());
+    }
+  }
+
+  // INSERT INTO table (dedup, c1, c2) VALUES ($1::bigint, $2::type, $3::type) ON CONFLICT DO NOTHING
+  void buildSql() {
+    if (sql.length() > 0) {
+      return;
+    }
+    sql = "INSERT INTO ";
+    sql += table;
+    sql += " (";
+    sql += dedupColumn;
+    for (size_t c = 0; c < Columns; c++) {
+      sql += ", ";
+      sql += columns[c];
+    }
+    sql += ") VALUES ($1::bigint";
+    for (size_t c = 0; c < Columns; c++) {
+      sql += ", $";
+      sql += static_cast<unsigned long>(c + 2);
+      if (types[c] != nullptr) {
+        sql += "::";
+        sql += types[c];
+      }
+    }
+    sql += ") ON CONFLICT DO NOTHING";
+  }
+
+  Client& client;
+  NeonOutboxStorage<Bytes>& storage;
+  const char* table;
+  const char* dedupColumn;
+  const char* const* columns;
+  const char* const* types;
+  const char* spillPath;
+  uint32_t maxRows = 0;
+  uint32_t maxBytes = 0;
+  uint32_t maxAge = 0;
+  uint32_t corruptRecords = 0;
+  String sql;
+};
+
+#endif /* ARDUINO_ARCH_ESP32 */
+
+#endif /* NEONPOSTGRESOUTBOX_H */
@@ -2,14 +2,456 @@
 // Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
 // MIT License
 
-#ifndef NEONPOSTGRESOVERTTPPROXYCLIENT_H
+#ifndef NEONPOSTGRESOVERHTTPPROXYCLIENT_H
 #define NEONPOSTGRESOVERHTTPPROXYCLIENT_H
 #include <ArduinoJson.h>
 #include "WiFiClient.h"
 #include <cstring>
+#include "NeonPostgresAllocator.h"
+#include "NeonPostgresPreparedStatement.h"
 
-class NeonPostgresOverHTTPProxyClient {
+// number of queries in a transaction that can have their own result filter,
+// see NeonPostgresOverHTTPProxyClient::setFilterForTransactionQuery()
+#ifndef NEON_MAX_TRANSACTION_QUERY_FILTERS
+#define NEON_MAX_TRANSACTION_QUERY_FILTERS 8
+#endif
+
+// size of the buffer on the stack used to coalesce the writes of a request into few large writes,
+// see NeonPostgresOverHTTPProxyClient::setWriteBuffer() for a larger buffer
+#ifndef NEON_WRITE_BUFFER_SIZE
+#define NEON_WRITE_BUFFER_SIZE 256
+#endif
+
+// number of response headers that can be kept with NeonPostgresOverHTTPProxyClient::captureResponseHeader()
+#ifndef NEON_MAX_RESPONSE_HEADERS
+#define NEON_MAX_RESPONSE_HEADERS 2
+#endif
+
+// maximum length of a response header line that is evaluated, the rest of longer lines is ignored
+#ifndef NEON_RESPONSE_LINE_SIZE
+#define NEON_RESPONSE_LINE_SIZE 64
+#endif
+
+// Define NEON_POSTGRES_INSTRUMENTATION before including this header to record the duration of the phases
+// of each request and counters, see NeonPostgresOverHTTPProxyClient::getLastTimings().
+// Without it the instrumentation costs neither memory nor time.
+
+// number of different error messages counted separately by the instrumentation, the others are counted together
+#ifndef NEON_INSTRUMENTATION_ERRORS
+#define NEON_INSTRUMENTATION_ERRORS 4
+#endif
+
+// number of buckets of the latency histogram, bucket i counts requests that took less than 16 << i milliseconds
+#ifndef NEON_LATENCY_BUCKETS
+#define NEON_LATENCY_BUCKETS 12
+#endif
+
+// sizes of the message and detail of the last SQL error kept by each client, longer texts are truncated,
+// see NeonPostgresOverHTTPProxyClient::getSqlError()
+#ifndef NEON_SQL_ERROR_MESSAGE_SIZE
+#define NEON_SQL_ERROR_MESSAGE_SIZE 128
+#endif
+
+#ifndef NEON_SQL_ERROR_DETAIL_SIZE
+#define NEON_SQL_ERROR_DETAIL_SIZE 96
+#endif
+
+// size of the buffer in each client that collects the response from the Wifi client in few large reads,
+// see NeonPostgresOverHTTPProxyClient::setReadBuffer() for a larger buffer
+#ifndef NEON_READ_BUFFER_SIZE
+#define NEON_READ_BUFFER_SIZE 64
+#endif
+
+/**
+ * @brief Keeps the TLS session of the transport across reconnects, so that a new connection can resume the
+ *        session with a short handshake instead of a full one. Implementations depend on the TLS client,
+ *        see NeonBearSSLSessionCache in NeonPostgresTlsSession.h.
+ */
+class NeonTlsSessionCache {
+public:
+  virtual ~NeonTlsSessionCache() {}
+
+  // called before every connect() of the client, hand the cached session to the transport
+  virtual void beforeConnect(Client& client) = 0;
+
+  // called after every connect() of the client, connected is false if the connection failed
+  virtual void afterConnect(Client& client, bool connected) = 0;
+};
+
+/**
+ * @brief Duration of the phases of the last request in microseconds and its size,
+ *        see NeonPostgresOverHTTPProxyClient::getLastTimings()
+ */
+struct NeonRequestTimings {
+  // DNS lookup through the resolver set with setResolver(), 0 if the cached address was used
+  unsigned long resolveMicros;
+  // TCP and TLS handshake and, without a resolver, the DNS lookup, 0 if a kept-alive connection was reused
+  unsigned long connectMicros;
+  // writing the request
+  unsigned long sendMicros;
+  // from the end of the request to the first byte of the response
+  unsigned long waitMicros;
+  // status line and headers
+  unsigned long headMicros;
+  // parsing the body and skipping what is left of it, for a cursor this includes the time between nextRow() calls
+  unsigned long parseMicros;
+  unsigned long totalMicros;
+  // millis() at the start of the request
+  unsigned long startMillis;
+  size_t bytesSent;
+  size_t bytesReceived;
+  // peak memory of the result JsonDocument and parsing buffers during the request
+  size_t resultMemory;
+  bool reused;
+};
+
+/**
+ * @brief Counters accumulated over all requests since construction or
+ *        NeonPostgresOverHTTPProxyClient::resetCounters()
+ */
+struct NeonRequestCounters {
+  uint32_t requests;
+  uint32_t failures;
+  // new connections to the proxy
+  uint32_t connects;
+  // requests repeated because the kept-alive connection had been closed by the proxy
+  uint32_t retries;
+  // the first NEON_INSTRUMENTATION_ERRORS different error messages, truncated, and how often they occurred
+  struct {
+    char errorMessage[32];
+    uint32_t count;
+  } failuresByError[NEON_INSTRUMENTATION_ERRORS];
+  // failures with other error messages
+  uint32_t otherFailures;
+  // bucket i counts requests that took less than 16 << i milliseconds, the last bucket all longer ones
+  uint32_t latencyHistogram[NEON_LATENCY_BUCKETS];
+};
+
+/**
+ * @brief Details of a result that exceeded the memory budget, see
+ *        NeonPostgresOverHTTPProxyClient::setMemoryBudget()
+ */
+struct NeonMemoryBudgetError {
+  // memory the result would have needed at the allocation that was refused, more is needed for the complete result
+  size_t bytesNeeded;
+  size_t budget;
+  // rows in the partial result when parsing stopped, the last one can be incomplete
+  size_t rowsParsed;
+};
+
+/**
+ * @brief The SQL error returned by the database, see NeonPostgresOverHTTPProxyClient::getSqlError()
+ */
+struct NeonSqlErrorDetails {
+  char message[NEON_SQL_ERROR_MESSAGE_SIZE];
+  // SQLSTATE, for example "23505" for a unique violation
+  char code[6];
+  char detail[NEON_SQL_ERROR_DETAIL_SIZE];
+  // 1-based position of the error in the statement text, 0 if the error has no position
+  int position;
+
+  // a data exception (class 22) or integrity constraint violation (class 23): the values are rejected,
+  // sending them again fails the same way
+  bool isDataError() const {
+    return code[0] == '2' && (code[1] == '2' || code[1] == '3');
+  }
+};
+
+/**
+ * @brief One statement of NeonPostgresOverHTTPProxyClient::executePipeline() and its outcome
+ */
+struct NeonPipelineStatement {
+  // prepared statement with its parameters
+  NeonPreparedStatement* statement;
+  // document that receives the result, nullptr if only success or failure is of interest
+  JsonDocument* result;
+  // set by executePipeline(): nullptr on success, the SQL error or why the statement has no result
+  const char* errorMessage;
+  // set by executePipeline() if the statement failed with an SQL error, errorMessage then points to its message
+  NeonSqlErrorDetails sqlError;
+};
+
+/**
+ * @brief Options of a transaction, see NeonPostgresOverHTTPProxyClient::startTransaction().
+ *        Combine an isolation level with NeonReadOnly and NeonDeferrable, for example
+ *        NeonReadOnly | NeonRepeatableRead.
+ */
+enum NeonTransactionOption : uint8_t {
+  // read-write with the default isolation level of the database
+  NeonDefaultTransaction = 0,
+  // the transaction does not write, it takes no write locks and no transaction id
+  NeonReadOnly = 1,
+  // together with NeonReadOnly and NeonSerializable: wait for a safe snapshot instead of risking a serialization failure
+  NeonDeferrable = 2,
+  NeonReadCommitted = 1 << 2,
+  NeonRepeatableRead = 2 << 2,
+  NeonSerializable = 3 << 2
+};
+
+/**
+ * @brief Classification of the error of the last request, see NeonPostgresOverHTTPProxyClient::getLastErrorKind()
+ */
+enum NeonErrorKind : uint8_t {
+  NeonNoError,
+  // connecting to the proxy failed or the request could not be written at all, it was not executed
+  NeonConnectError,
+  // no response in time or the connection broke while sending, the statement may have been executed
+  NeonTimeoutError,
+  // HTTP status 5xx from the proxy
+  NeonServerError,
+  // any other unexpected HTTP status, for example 401 or 404
+  NeonHttpError,
+  // the response was incomplete or could not be parsed
+  NeonResponseError,
+  // the result does not fit into memory or the memory budget
+  NeonMemoryError,
+  // the database returned an error, see getSqlError()
+  NeonSqlError,
+  // serialization failure or deadlock, the transaction was rolled back and can be repeated
+  NeonSqlRetryableError,
+  // the request was rejected before sending, for example an unprepared statement
+  NeonRequestError,
+  // the circuit breaker is open, the request was not sent
+  NeonCircuitOpenError
+};
+
+/**
+ * @brief When execute() and executeTransaction() retry a failed request and when the circuit breaker opens,
+ *        see NeonPostgresOverHTTPProxyClient::setRetryPolicy()
+ */
+struct NeonRetryPolicy {
+  // attempts per request including the first one, 1 to not retry
+  uint8_t maxAttempts;
+  // wait before the first retry in milliseconds, doubled for every further retry
+  unsigned long initialBackoff;
+  unsigned long maxBackoff;
+  // consecutive failed requests with a connect, timeout, server or response error that open the circuit breaker,
+  // 0 to never open it
+  uint8_t breakerThreshold;
+  // milliseconds the breaker stays open, then one request is let through as probe
+  unsigned long breakerCooldown;
+};
+
+/**
+ * @brief Compile-time configuration of a BasicNeonClient. Derive from it and override single
+ *        members to strip subsystems or change buffer sizes:
+ * ```cpp
+ * struct SmallFeatures : NeonDefaultFeatures {
+ *   static const bool Transactions = false;
+ *   static const size_t ReadBufferSize = 32;
+ * };
+ * BasicNeonClient<EthernetClient, SmallFeatures> sqlClient(client, DATABASE_URL, NEON_PROXY);
+ * ```
+ * The defaults are those of NeonPostgresOverHTTPProxyClient and follow the NEON_ macros above.
+ */
+struct NeonDefaultFeatures {
+  // startTransaction(), executeTransaction() and their two JsonDocuments
+  static const bool Transactions = true;
+  // setKeepAlive(), without it every request opens and closes its own connection
+  static const bool KeepAlive = true;
+  // getLastTimings() and getCounters(), see NEON_POSTGRES_INSTRUMENTATION
+#if defined(NEON_POSTGRES_INSTRUMENTATION)
+  static const bool Instrumentation = true;
+#else
+  static const bool Instrumentation = false;
+#endif
+  // size of the HTTP status line kept for error messages
+  static const size_t StatusSize = 32;
+  static const size_t ResponseLineSize = NEON_RESPONSE_LINE_SIZE;
+  static const size_t MaxResponseHeaders = NEON_MAX_RESPONSE_HEADERS;
+  static const size_t MaxTransactionQueryFilters = NEON_MAX_TRANSACTION_QUERY_FILTERS;
+  static const size_t ReadBufferSize = NEON_READ_BUFFER_SIZE;
+  static const size_t WriteBufferSize = NEON_WRITE_BUFFER_SIZE;
+};
+
+/**
+ * @brief Features for boards with little RAM: single statements only, a new connection per request
+ *        and small buffers.
+ */
+struct NeonMinimalFeatures : NeonDefaultFeatures {
+  static const bool Transactions = false;
+  static const bool KeepAlive = false;
+  static const bool Instrumentation = false;
+  static const size_t StatusSize = 16;
+  static const size_t ResponseLineSize = 48;
+  static const size_t MaxResponseHeaders = 1;
+  static const size_t ReadBufferSize = 32;
+  static const size_t WriteBufferSize = 64;
+};
+
+/**
+ * @brief Timings and counters of a BasicNeonClient, see NeonPostgresOverHTTPProxyClient::getLastTimings().
+ *        Without Features::Instrumentation all hooks are empty and it has no members.
+ */
+template <bool Enabled>
+class NeonClientInstrumentation {
+public:
+  void start(size_t) {}
+  void phase(unsigned long NeonRequestTimings::*) {}
+  void connect() {}
+  void retry() {}
+  void sent(size_t) {}
+  void end(const char*, size_t, size_t) {}
+};
+
+template <>
+class NeonClientInstrumentation<true> {
+public:
+  // received is the number of bytes read from the transport so far
+  void start(size_t received) {
+    memset(&timings, 0, sizeof(timings));
+    timings.startMillis = millis();
+    timings.reused = true;
+    requestStartMicros = micros();
+    phaseStartMicros = requestStartMicros;
+    receivedAtStart = received;
+    counters.requests++;
+  }
+
+  // add the time since the end of the previous phase to a phase
+  void phase(unsigned long NeonRequestTimings::*phase) {
+    unsigned long now = micros();
+    timings.*phase += now - phaseStartMicros;
+    phaseStartMicros = now;
+  }
+
+  void connect() {
+    timings.reused = false;
+    counters.connects++;
+  }
+
+  void retry() {
+    counters.retries++;
+  }
+
+  void sent(size_t bytes) {
+    timings.bytesSent += bytes;
+  }
+
+  // resultMemory is the peak memory of the result during the request
+  void end(const char* errorMessage, size_t received, size_t resultMemory) {
+    timings.totalMicros = micros() - requestStartMicros;
+    timings.bytesReceived = received - receivedAtStart;
+    timings.resultMemory = resultMemory;
+    lastTimings = timings;
+    unsigned long ms = timings.totalMicros / 1000;
+    size_t bucket = 0;
+    while (bucket < NEON_LATENCY_BUCKETS - 1 && ms >= (16UL << bucket)) {
+      bucket++;
+    }
+    counters.latencyHistogram[bucket]++;
+    if (errorMessage == nullptr) {
+      return;
+    }
+    counters.failures++;
+    for (size_t i = 0; i < NEON_INSTRUMENTATION_ERRORS; i++) {
+      char* counted = counters.failuresByError[i].errorMessage;
+      if (counted[0] == 0) {
+        strncpy(counted, errorMessage, sizeof(counters.failuresByError[i].errorMessage) - 1);
+      }
+      if (strncmp(counted, errorMessage, sizeof(counters.failuresByError[i].errorMessage) - 1) == 0) {
+        counters.failuresByError[i].count++;
+        return;
+      }
+    }
+    counters.otherFailures++;
+  }
+
+  unsigned long latencyPercentile(uint8_t percent) const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < NEON_LATENCY_BUCKETS; i++) {
+      total += counters.latencyHistogram[i];
+    }
+    if (total == 0) {
+      return 0;
+    }
+    uint64_t rank = (static_cast<uint64_t>(total) * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < NEON_LATENCY_BUCKETS; i++) {
+      seen += counters.latencyHistogram[i];
+      if (seen >= rank) {
+        return 16UL << i;
+      }
+    }
+    return 16UL << (NEON_LATENCY_BUCKETS - 1);
+  }
+
+  NeonRequestTimings lastTimings = {};
+  NeonRequestCounters counters = {};
+
+private:
+  NeonRequestTimings timings = {};
+  unsigned long requestStartMicros = 0;
+  unsigned long phaseStartMicros = 0;
+  size_t receivedAtStart = 0;
+};
+
+/**
+ * @brief The documents and filters of the transaction of a BasicNeonClient.
+ *        Without Features::Transactions it has no members.
+ */
+template <bool Enabled, size_t QueryFilters>
+struct NeonTransactionState {
+  NeonTransactionState(ArduinoJson::Allocator* requestAllocator, ArduinoJson::Allocator* resultAllocator)
+    : memory(resultAllocator), request(requestAllocator), response(&memory) {
+    request.clear();
+    response.clear();
+    request["queries"].to<JsonArray>();
+  }
+
+  const JsonDocument* queryFilter(size_t index) const {
+    return index < QueryFilters ? queryFilters[index] : nullptr;
+  }
+
+  // counts and limits the memory of the result, declared before the document that uses it
+  NeonTrackingAllocator memory;
+  JsonDocument request;
+  JsonDocument response;
+  const JsonDocument* responseFilter = nullptr;
+  const JsonDocument* queryFilters[QueryFilters] = {};
+  bool hasQueryFilters = false;
+  // NeonTransactionOption flags sent as request headers
+  uint8_t options = NeonDefaultTransaction;
+};
+
+template <size_t QueryFilters>
+struct NeonTransactionState<false, QueryFilters> {
+  NeonTransactionState(ArduinoJson::Allocator*, ArduinoJson::Allocator*) {}
+
+  const JsonDocument* queryFilter(size_t) const {
+    return nullptr;
+  }
+};
+
+/**
+ * @brief The database client, NeonPostgresOverHTTPProxyClient is the usual form with a WiFiClient.
+ *
+ * @tparam Transport the Arduino Client to connect with, for example WiFiClient, WiFiClientSecure,
+ *                   EthernetClient or a GSM client. TLS must be done by the transport
+ * @tparam Features subsystems and buffer sizes, see NeonDefaultFeatures
+ */
+template <typename Transport = WiFiClient, typename Features = NeonDefaultFeatures>
+class BasicNeonClient {
 public:
+  // the features of the client, for helpers that adapt to them
+  typedef Features FeatureSet;
+
+  /**
+     * @brief Resolves a hostname, usually a wrapper of WiFi.hostByName() of your Wifi library.
+     *
+     * @return 1 on success
+     */
+  typedef int (*Resolver)(const char* host, IPAddress& ip);
+
+  /**
+     * @brief Connects the client to an address, host is the hostname for TLS server name indication (SNI).
+     *        Allows to use a connect() method of the transport that takes both, for example
+     *        WiFiClientSecure::connect(ip, port, host, rootCA, cert, key) on ESP32.
+     *
+     * @return 1 on success
+     */
+  typedef int (*IpConnector)(Transport& client, const IPAddress& ip, uint16_t port, const char* host);
+
 
   /**
      * @brief Constructs an database client that connects over Wifi to a Neon database (https://neon.tech)
@@ -42,14 +484,245 @@ public:
      *                  copied
      * @param proxyPort Proxy listening port. Usually 443 for https.
      */
-  NeonPostgresOverHTTPProxyClient(WiFiClient& client, const char* neonPostgresConnectionString, const char* neonProxy, int proxyPort = 443)
-    : client(client), connstr(neonPostgresConnectionString), proxy(neonProxy), proxyPort(proxyPort) {
+  BasicNeonClient(Transport& client, const char* neonPostgresConnectionString, const char* neonProxy, int proxyPort = 443)
+    : BasicNeonClient(client, neonPostgresConnectionString, neonProxy, proxyPort,
+                      NeonHeapAllocator::instance(), NeonHeapAllocator::instance()) {}
+
+  /**
+     * @brief Constructs a database client whose JsonDocuments use the given ArduinoJson allocator
+     *        instead of the heap, for example to put them into PSRAM.
+     *        See the constructor above for the other parameters.
+     *
+     * @param allocator allocator for all JsonDocuments of the client.
+     *                  This pointer must be valid for the complete lifetime of the NeonPostgresOverHTTPProxyClient
+     */
+  BasicNeonClient(Transport& client, const char* neonPostgresConnectionString, const char* neonProxy, int proxyPort,
+                  ArduinoJson::Allocator* allocator)
+    : BasicNeonClient(client, neonPostgresConnectionString, neonProxy, proxyPort, allocator, allocator) {}
+
+  /**
+     * @brief Constructs a database client with separate ArduinoJson allocators for the statements and the results.
+     *        See the first constructor for the other parameters.
+     *
+     * @param requestAllocator allocator for the statement documents (setQuery(), addQueryToTransaction())
+     * @param resultAllocator allocator for the result documents and the buffer of executeAsync().
+     *                        Both pointers must be valid for the complete lifetime of the NeonPostgresOverHTTPProxyClient
+     */
+  BasicNeonClient(Transport& client, const char* neonPostgresConnectionString, const char* neonProxy, int proxyPort,
+                  ArduinoJson::Allocator* requestAllocator, ArduinoJson::Allocator* resultAllocator)
+    : BasicNeonClient(client, neonPostgresConnectionString, neonProxy, proxyPort, requestAllocator, resultAllocator,
+                      resultAllocator) {}
+
+  /**
+     * @brief Constructs a database client with separate ArduinoJson allocators for the statements, the result of
+     *        execute() and the result of executeTransaction().
+     *        A NeonArenaAllocator is reset when everything allocated from it has been freed. A result document is
+     *        cleared before the response of its next successful request is parsed, so with one arena per result
+     *        document the arena is reset for every request and parsing the results never calls malloc().
+     *        Do not share an arena between the two results: while one of them holds memory the arena is never reset.
+     * @example
+     * ```cpp
+     * NeonArenaAllocator<8192> resultArena;
+     * NeonArenaAllocator<4096> transactionArena;
+     * NeonPostgresOverHTTPProxyClient sqlClient(client, DATABASE_URL, NEON_PROXY, 443,
+     *                                           NeonHeapAllocator::instance(), &resultArena, &transactionArena);
+     * ```
+     * See the first constructor for the other parameters.
+     *
+     * @param requestAllocator allocator for the statement documents (setQuery(), addQueryToTransaction())
+     * @param resultAllocator allocator for the result document of execute(), executeAsync() and executeCursor()
+     *                        and the buffer of executeAsync()
+     * @param transactionResultAllocator allocator for the result document of executeTransaction() and the buffer
+     *                                   of executeTransactionAsync().
+     *                                   All pointers must be valid for the complete lifetime of the NeonPostgresOverHTTPProxyClient
+     */
+  BasicNeonClient(Transport& client, const char* neonPostgresConnectionString, const char* neonProxy, int proxyPort,
+                  ArduinoJson::Allocator* requestAllocator, ArduinoJson::Allocator* resultAllocator,
+                  ArduinoJson::Allocator* transactionResultAllocator)
+    : responseMemory(resultAllocator), request(requestAllocator), response(&responseMemory), txn(requestAllocator, transactionResultAllocator),
+      client(client), connstr(neonPostgresConnectionString), proxy(neonProxy), proxyPort(proxyPort), resultMemory(&responseMemory) {
     request.clear();
     response.clear();
-    txnRequest.clear();
-    txnResponse.clear();
     request["params"].to<JsonArray>();
-    txnRequest["queries"].to<JsonArray>();
+  }
+
+  ~BasicNeonClient() {
+    freeAsyncBody();
+  }
+
+  /**
+     * @brief Keep the connection to the proxy open between execute() and executeTransaction() calls.
+     *        By default every statement connects to the proxy and closes the connection afterwards,
+     *        so each statement pays a full TCP and TLS handshake.
+     *        With keep-alive enabled the connection is reused for the next statement. If the proxy
+     *        has closed the connection while it was idle the client reconnects transparently.
+     * @example
+     * ```cpp
+     * // reuse the connection, close it locally after 30 seconds without a statement
+     * sqlClient.setKeepAlive(true, 30000);
+     * ```
+     *
+     * @param enable true to reuse the connection, false to close it after each request
+     * @param idleTimeout maximum time in milliseconds an idle connection is reused. Choose it lower than
+     *                    the idle timeout of the proxy, so the connection is closed before the proxy drops it.
+     */
+  void setKeepAlive(bool enable, unsigned long idleTimeout = 30000) {
+    static_assert(Features::KeepAlive, "setKeepAlive() needs Features::KeepAlive");
+    keepAlive = enable;
+    this->idleTimeout = idleTimeout;
+    if (!enable) {
+      closeConnection();
+    }
+  }
+
+  /**
+     * @brief Use a larger buffer to coalesce the writes of a request.
+     *        The HTTP headers and the Json payload are collected in a buffer and written to the Wifi client
+     *        in chunks of the buffer size instead of many small writes. On WiFiNINA every write is an SPI
+     *        transaction and often a separate TLS record, so fewer, larger writes save time and radio-on time.
+     *        Without this call a buffer of Features::WriteBufferSize (NEON_WRITE_BUFFER_SIZE) bytes on the stack is used.
+     * @example
+     * ```cpp
+     * // one TCP segment per write
+     * static uint8_t writeBuffer[1436];
+     * sqlClient.setWriteBuffer(writeBuffer, sizeof(writeBuffer));
+     * ```
+     *
+     * @param buffer the buffer, nullptr to use the default buffer on the stack.
+     *               This buffer must be valid while it is set, it is NOT copied
+     * @param size size of the buffer in bytes
+     */
+  void setWriteBuffer(uint8_t* buffer, size_t size) {
+    writeBuffer = size > 0 ? buffer : nullptr;
+    writeBufferSize = size;
+  }
+
+  /**
+     * @brief Resolve the proxy hostname once and connect by IP address while the address is cached,
+     *        instead of a DNS lookup by the Wifi library for every new connection.
+     *        The Host header still contains the hostname. If connecting to a cached address fails, the
+     *        hostname is resolved again; if resolving fails, the client connects by hostname.
+     *
+     *        Caveat: the proxy needs the hostname for TLS server name indication (SNI). Most TLS clients
+     *        (WiFiNINA's WiFiSSLClient, ESP32's WiFiClientSecure) do not send SNI when connect() is called with
+     *        an IP address; then also pass an IpConnector that connects with both address and hostname.
+     * @example
+     * ```cpp
+     * sqlClient.setResolver([](const char* host, IPAddress& ip) { return (int)WiFi.hostByName(host, ip); },
+     *                       600000,
+     *                       [](WiFiClient& c, const IPAddress& ip, uint16_t port, const char* host) {
+     *                         return static_cast<WiFiClientSecure&>(c).connect(ip, port, host, nullptr, nullptr, nullptr);
+     *                       });
+     * ```
+     *
+     * @param resolver function that resolves the hostname, nullptr to connect by hostname again
+     * @param ttl milliseconds after which the hostname is resolved again
+     * @param connector function that connects to the resolved address, nullptr to call client.connect(ip, port)
+     */
+  void setResolver(Resolver resolver, unsigned long ttl = 300000, IpConnector connector = nullptr) {
+    this->resolver = resolver;
+    resolveTtl = ttl;
+    ipConnector = connector;
+    resolved = false;
+  }
+
+  /**
+     * @brief Resume the TLS session of the previous connection when the client has to reconnect,
+     *        for example after the proxy closed an idle connection or after deep sleep.
+     * @example
+     * ```cpp
+     * // ESP8266 with BearSSL::WiFiClientSecure client
+     * #include <NeonPostgresTlsSession.h>
+     * NeonBearSSLSessionCache sessionCache(client);
+     * ...
+     * sqlClient.setTlsSessionCache(&sessionCache);
+     * ```
+     *
+     * @param cache the session cache for the transport, nullptr for none.
+     *              This pointer must be valid while it is set, it is NOT copied
+     */
+  void setTlsSessionCache(NeonTlsSessionCache* cache) {
+    tlsSessionCache = cache;
+  }
+
+  /**
+     * @brief Use a larger buffer to read the response.
+     *        The status line, headers and body are read from the Wifi client in chunks of up to the buffer
+     *        size instead of one byte at a time. On WiFiNINA every read is an SPI transaction, so parsing
+     *        a result of several kilobytes becomes limited by the bandwidth instead of the per byte overhead.
+     *        Without this call a buffer of Features::ReadBufferSize (NEON_READ_BUFFER_SIZE) bytes inside the client is used.
+     *        Closes a connection kept open by setKeepAlive().
+     * @example
+     * ```cpp
+     * static uint8_t readBuffer[512];
+     * sqlClient.setReadBuffer(readBuffer, sizeof(readBuffer));
+     * ```
+     *
+     * @param buffer the buffer, nullptr to use the default buffer inside the client.
+     *               This buffer must be valid while it is set, it is NOT copied
+     * @param size size of the buffer in bytes
+     */
+  void setReadBuffer(uint8_t* buffer, size_t size) {
+    abandonPendingRequest();
+    closeConnection();
+    input.setBuffer(buffer, size);
+  }
+
+  /**
+     * @brief Keep the value of a response header of the proxy for the following requests, see getResponseHeader().
+     *        Values longer than Features::ResponseLineSize minus the name are truncated.
+     * @example
+     * ```cpp
+     * sqlClient.captureResponseHeader("Neon-Batch-Isolation-Level");
+     * ```
+     *
+     * @param name name of the header, compared case-insensitively.
+     *             This pointer must be valid for the complete lifetime of the client, it is NOT copied
+     *
+     * @return false if Features::MaxResponseHeaders headers are already kept
+     */
+  bool captureResponseHeader(const char* name) {
+    if (capturedHeaderCount == Features::MaxResponseHeaders) {
+      return false;
+    }
+    capturedHeaders[capturedHeaderCount].name = name;
+    capturedHeaders[capturedHeaderCount].received = false;
+    capturedHeaderCount++;
+    return true;
+  }
+
+  /**
+     * @brief Get the value of a header set with captureResponseHeader() in the last response.
+     *
+     * @return value of the header, nullptr if it was not in the last response or is not kept
+     */
+  const char* getResponseHeader(const char* name) {
+    for (size_t i = 0; i < capturedHeaderCount; i++) {
+      if (capturedHeaders[i].received && strcasecmp(capturedHeaders[i].name, name) == 0) {
+        return capturedHeaders[i].value;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+     * @brief HTTP status code of the last response, 0 if no status line was received
+     */
+  int getStatusCode() {
+    return statusCode;
+  }
+
+  /**
+     * @brief Close a connection kept open by setKeepAlive(), for example before the board goes to sleep.
+     *        The next statement opens a new connection.
+     */
+  void closeConnection() {
+    if (connectionOpen) {
+      client.stop();
+      connectionOpen = false;
+    }
+    // bytes received on the old connection must not be taken for the next response
+    input.clear();
   }
 
   /**
@@ -75,6 +748,26 @@ public:
     request["query"] = query;
   }
 
+  /**
+     * @brief Like setQuery() but the statement text is stored by reference instead of being copied into
+     *        the request, which saves a heap copy of long constant statements for every statement set.
+     * @example
+     * ```cpp
+     * const char* insertSensorValue = R"SQL(
+     * INSERT INTO sensorvalues (sensor_name, sensor_value) VALUES ($1, $2)
+     * )SQL";
+     * ...
+     * sqlClient.setStaticQuery(insertSensorValue);
+     * ```
+     *
+     * @param query SQL statement text, a string literal or a constant character array.
+     *              This pointer must be valid until the next setQuery() or setStaticQuery(), it is NOT copied.
+     *              Strings in PROGMEM or F() on AVR and ESP8266 cannot be read by pointer, use setQuery() for them
+     */
+  void setStaticQuery(const char* query) {
+    request["query"] = staticText(query);
+  }
+
   /**
      * @brief Get the parameter array to clear and set the parameter values for the next statement 
      *        execution.
@@ -104,7 +797,167 @@ public:
     * @return nullptr on success, error message in case of failure
     */
   const char* execute(unsigned long timeout = 20000) {
-    return executeInternal(request, response, timeout);
+    return executeInternal(request, response, responseMemory, timeout, responseFilter);
+  }
+
+  /**
+    * Like execute() but keep only the parts of the result selected by filter, for this call only.
+    * The filter is an ArduinoJson filter document, see https://arduinojson.org/v7/how-to/deserialize-a-very-large-document/
+    * @example
+    * ```cpp
+    * JsonDocument filter;
+    * filter["rows"][0]["sensor_value"] = true;
+    * filter["rowCount"] = true;
+    * const char* errorMessage = sqlClient.execute(filter);
+    * ```
+    *
+    * @param filter filter applied to the result
+    * @param timeout maximum time in milliseconds to wait for response
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* execute(const JsonDocument& filter, unsigned long timeout = 20000) {
+    return executeInternal(request, response, responseMemory, timeout, &filter);
+  }
+
+  /**
+    * Like execute() but send a statement prepared with NeonPreparedStatement::prepare() and its parameters
+    * instead of the statement set with setQuery(). The result is available with the same methods as after execute().
+    * @example
+    * ```cpp
+    * JsonArray params = insertStatement.getParams();
+    * params.add(42);
+    * const char* errorMessage = sqlClient.execute(insertStatement);
+    * ```
+    *
+    * @param statement the prepared statement
+    * @param timeout maximum time in milliseconds to wait for response
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* execute(NeonPreparedStatement& statement, unsigned long timeout = 20000) {
+    if (!statement.isPrepared()) {
+      errorKind = NeonRequestError;
+      return "statement is not prepared";
+    }
+    return executeInternal(statement, response, responseMemory, timeout, responseFilter);
+  }
+
+  /**
+    * Send several independent prepared statements back-to-back on one connection before reading
+    * any response, then read the responses in order. Compared to one execute() per statement this
+    * saves a round trip per statement, compared to a transaction the statements succeed or fail
+    * independently. The result of statement i is parsed into statements[i].result with the response
+    * filter, its SQL error is copied into statements[i].sqlError and statements[i].errorMessage points
+    * to its message. A result that cannot be parsed, for example for lack of memory, only fails its own
+    * statement. If the connection fails, the statement whose response was being read gets the transport
+    * error and the following ones "not executed: pipeline aborted": their responses were not read, so
+    * they may still have been executed if they had been sent. If a statement is not prepared, nothing
+    * is sent: it gets "statement is not prepared" and all others "not executed".
+    * @example
+    * ```cpp
+    * JsonDocument temperature, humidity;
+    * NeonPipelineStatement statements[] = {
+    *   { &insertReading, nullptr, nullptr },
+    *   { &selectTemperature, &temperature, nullptr },
+    *   { &selectHumidity, &humidity, nullptr },
+    * };
+    * const char* errorMessage = sqlClient.executePipeline(statements, 3);
+    * if (errorMessage == nullptr && statements[1].errorMessage == nullptr) {
+    *   ...
+    * }
+    * ```
+    *
+    * @param statements statements and their result documents, the prepared statements must not change
+    *                   until executePipeline() returns
+    * @param count number of statements
+    * @param timeout maximum time in milliseconds to wait for each response
+    *
+    * @return nullptr if a response was received for every statement, the transport error otherwise.
+    *         SQL errors are only reported per statement
+    */
+  const char* executePipeline(NeonPipelineStatement* statements, size_t count, unsigned long timeout = 20000) {
+    if (count == 0) {
+      return nullptr;
+    }
+    // every statement gets a fresh outcome, also when the pipeline is not sent at all
+    const char* unprepared = nullptr;
+    for (size_t i = 0; i < count; i++) {
+      statements[i].errorMessage = "not executed";
+      if (!statements[i].statement->isPrepared()) {
+        statements[i].errorMessage = unprepared = "statement is not prepared";
+      }
+    }
+    if (unprepared != nullptr) {
+      errorKind = NeonRequestError;
+      return unprepared;
+    }
+    abandonPendingRequest();
+    startResult(responseMemory);
+    instrumentStart();
+    if (isCircuitOpen()) {
+      errorKind = NeonCircuitOpenError;
+      return "circuit breaker open";
+    }
+    bool reused = false;
+    const char* errorMessage = openConnection(reused);
+    if (errorMessage == nullptr) {
+      errorMessage = sendPipelineReadHead(statements, count, timeout);
+      if (errorMessage != nullptr && reused && staleConnection) {
+        // the proxy closed the idle connection before we noticed, nothing was executed
+        instrumentRetry();
+        closeConnection();
+        errorMessage = openConnection(reused);
+        if (errorMessage == nullptr) {
+          errorMessage = sendPipelineReadHead(statements, count, timeout);
+        }
+      }
+    }
+    // the SQL errors are reported per statement, not as the outcome of the pipeline
+    JsonDocument noResult(&responseMemory);
+    size_t i = 0;
+    while (errorMessage == nullptr && i < count) {
+      statements[i].errorMessage = readPipelineResult(statements[i]);
+      i++;
+      if (i < count) {
+        // skip the rest of the previous body, the next response follows it
+        errorMessage = responseKeepAlive && body.drain() ? readHead(timeout) : "connection closed by proxy";
+      }
+    }
+    if (errorMessage != nullptr) {
+      // the response of statement i could not be read
+      statements[i++].errorMessage = errorMessage;
+    }
+    for (; i < count; i++) {
+      statements[i].errorMessage = "not executed: pipeline aborted";
+    }
+    sqlErrorParsed = false;
+    return endRequest(errorMessage, noResult);
+  }
+
+  /**
+    * Keep only the parts of the results of execute() and executeCursor() selected by filter.
+    * Most statements only need rows and rowCount, dropping fields (with dataTypeID, tableID, columnID
+    * and format of every column), command and rowAsArray saves a lot of memory for wide tables.
+    *
+    * @param filter ArduinoJson filter document, nullptr to keep the complete result.
+    *               This pointer must be valid while it is set, it is NOT copied
+    */
+  void setResponseFilter(const JsonDocument* filter) {
+    responseFilter = filter;
+  }
+
+  /**
+    * Keep only rows, rowCount and message of the results of execute() and executeCursor().
+    */
+  void useDefaultResponseFilter() {
+    static JsonDocument defaultFilter;
+    if (defaultFilter.isNull()) {
+      defaultFilter["rows"] = true;
+      defaultFilter["rowCount"] = true;
+      defaultFilter["message"] = true;
+    }
+    responseFilter = &defaultFilter;
   }
 
   /**
@@ -130,6 +983,41 @@ public:
     return response["fields"].as<JsonArray>();
   }
 
+  /**
+    * Return the rows of execute() and executeTransaction() as arrays of column values instead of
+    * objects with the column names as keys.
+    * This drops the column names repeated in every row and roughly halves the size of the response
+    * and the memory needed to parse it for wide rows. Use getColumnIndex() to find a column in a row.
+    * @example
+    * ```cpp
+    * sqlClient.setArrayMode(true);
+    * sqlClient.setQuery("SELECT sensor_name, sensor_value FROM sensorvalues");
+    * errorMessage = sqlClient.execute();
+    * int valueColumn = sqlClient.getColumnIndex("sensor_value");
+    * for (JsonArray row : sqlClient.getRows()) {
+    *   float sensor_value = row[valueColumn];
+    * }
+    * ```
+    *
+    * @param enable true to return rows as arrays, false (default) to return rows as objects
+    */
+  void setArrayMode(bool enable) {
+    arrayMode = enable;
+  }
+
+  /**
+    * After execution for a query get the position of a column in the rows returned in array mode,
+    * see setArrayMode(). Look up the index once per result, not once per row.
+    * If you use a response filter it must keep the name of the fields.
+    *
+    * @param name column name as returned in getFields()
+    *
+    * @return 0-based index of the column in a row, -1 if there is no such column
+    */
+  int getColumnIndex(const char* name) {
+    return findColumn(getFields(), name);
+  }
+
   /** Get complete query result as ArduinoJson JsonDocument.
     * Mostly used for debugging, normally
     * getRows(), getFields() and getRowCount() should be used.
@@ -151,20 +1039,120 @@ public:
     print.println();
   }
 
-  // --------------------------------------------------------------------
-  // same APIs as above with transaction support 
-  // allows to run multiple statements in a single transaction atomically
-  // --------------------------------------------------------------------
-
   /**
-     * @brief Specify the sql statement you want to execute in a transaction.
-     *        The statement text can use parameter markers.
-     *        If you use parameter markers you must also supply the parameter values before executing the
-     *        statement.
-     * @example
-     * ```cpp
-     * sqlClient.startTransaction();
-     * sqlClient.addQueryToTransaction("SELECT $1::int");
+    * Connect to proxy, send the SQL statement set with setQuery() and start reading the result
+    * row by row with nextRow() instead of parsing all rows into memory at once.
+    * Use this for queries that return more rows than fit into memory.
+    * The members of the result other than rows (rowCount, fields, command) are available through
+    * getRowCount(), getFields() and getRawJsonResult(). Members the proxy sends after the rows
+    * are only available once nextRow() has returned false.
+    * @example
+    * ```cpp
+    * sqlClient.setQuery("SELECT sensor_name, measure_time, sensor_value FROM sensorvalues");
+    * const char* errorMessage = sqlClient.executeCursor();
+    * JsonDocument row;
+    * while (errorMessage == nullptr && sqlClient.nextRow(row)) {
+    *   float sensor_value = row["sensor_value"];
+    *   ...
+    * }
+    * if (errorMessage == nullptr) {
+    *   errorMessage = sqlClient.getCursorError();
+    * }
+    * ```
+    *
+    * @param timeout maximum time in milliseconds to wait for response
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* executeCursor(unsigned long timeout = 20000) {
+    cursorError = nullptr;
+    const char* errorMessage = beginRequest(request, responseMemory, timeout);
+    cursorFilter = responseFilter;
+    if (errorMessage == nullptr && statusCode == 400) {
+      // like execute(), an SQL error keeps the previous result
+      return endRequest(parseSqlError(), response);
+    }
+    if (errorMessage == nullptr) {
+      response.clear();
+    }
+    if (errorMessage == nullptr && body.readNonWhitespace() != '{') {
+      errorMessage = "Invalid response";
+    }
+    if (errorMessage == nullptr) {
+      errorMessage = scanResultMembers(response, "rows", cursorFilter, false, cursorInRows);
+    }
+    if (errorMessage == nullptr && cursorInRows) {
+      cursorOpen = true;
+      return nullptr;
+    }
+    cursorInRows = false;
+    return endRequest(errorMessage, response);
+  }
+
+  /**
+    * After executeCursor() read the next row of the result.
+    *
+    * @param row JsonDocument that receives the row, its previous content is replaced
+    *
+    * @return true if a row was read, false at the end of the result or in case of failure,
+    *         see getCursorError()
+    */
+  bool nextRow(JsonDocument& row) {
+    if (!cursorInRows) {
+      return false;
+    }
+    DeserializationError err = cursorFilter != nullptr
+                                 ? deserializeJson(row, body, DeserializationOption::Filter(elementFilter((*cursorFilter)["rows"])))
+                                 : deserializeJson(row, body);
+    if (err) {
+      row.clear();
+      finishCursor(err.c_str());
+      return false;
+    }
+    int c = body.readNonWhitespace();
+    if (c == ']') {
+      finishCursor(nullptr);
+    } else if (c != ',') {
+      finishCursor("Invalid response");
+    }
+    return true;
+  }
+
+  /**
+    * After nextRow() returned false get the reason.
+    *
+    * @return nullptr if all rows have been read, error message in case of failure
+    */
+  const char* getCursorError() {
+    return cursorError;
+  }
+
+  /**
+    * Stop reading the rows of a result started with executeCursor() before all rows have been read.
+    * This closes the connection to the proxy.
+    */
+  void closeCursor() {
+    if (cursorOpen) {
+      cursorOpen = false;
+      cursorInRows = false;
+      closeConnection();
+    }
+  }
+
+  // --------------------------------------------------------------------
+  // same APIs as above with transaction support 
+  // allows to run multiple statements in a single transaction atomically
+  // --------------------------------------------------------------------
+
+  /**
+     * @brief Specify the sql statement you want to execute in a transaction.
+     *        The statement text can use parameter markers.
+     *        If you use parameter markers you must also supply the parameter values before executing the
+     *        statement.
+     * @example
+     * ```cpp
+     * sqlClient.startTransaction();
+     * sqlClient.addQueryToTransaction("SELECT $1::int");
      * JsonArray params1 = sqlClient.getParamsForTransactionQuery(0);
      * params1.clear();
      * params1.add(100);
@@ -172,12 +1160,29 @@ public:
      * @param query query SQL statement text (INSERT, UPDATE, DELETE,...) optionally with parameter markers.
      */
   void addQueryToTransaction(const char* query) {
+    static_assert(Features::Transactions, "transactions need Features::Transactions");
+    JsonDocument& txnRequest = this->txnRequest();
     JsonObject newQuery = txnRequest["queries"].add<JsonObject>();
     newQuery["query"] = query;
     // Create the params array inside the new object
     newQuery["params"].to<JsonArray>();
   }
 
+  /**
+     * @brief Like addQueryToTransaction() but the statement text is stored by reference instead of being
+     *        copied, see setStaticQuery().
+     *
+     * @param query SQL statement text. This pointer must be valid until the next startTransaction(),
+     *              it is NOT copied
+     */
+  void addStaticQueryToTransaction(const char* query) {
+    static_assert(Features::Transactions, "transactions need Features::Transactions");
+    JsonDocument& txnRequest = this->txnRequest();
+    JsonObject newQuery = txnRequest["queries"].add<JsonObject>();
+    newQuery["query"] = staticText(query);
+    newQuery["params"].to<JsonArray>();
+  }
+
   /**
      * @brief Get the parameter array for a statement in a transaction to clear and 
      *        set the parameter values for the next statement execution.
@@ -194,21 +1199,86 @@ public:
      * @param query query SQL statement text (INSERT, UPDATE, DELETE,...) optionally with parameter markers.
      */
   JsonArray getParamsForTransactionQuery(size_t queryIndex) {
-    if (queryIndex >= txnRequest["queries"].size()) {
+    if (queryIndex >= txnRequest()["queries"].size()) {
       return JsonArray();
     }
-    JsonObject query = txnRequest["queries"][queryIndex];
+    JsonObject query = txnRequest()["queries"][queryIndex];
     return query["params"];
   }
 
   /**
    * Reset the transaction state in case you have run a transaction before.
    * Clears all queries and responses.
+   * The options are sent as the Neon-Batch-Isolation-Level, Neon-Batch-Read-Only and Neon-Batch-Deferrable
+   * headers. A read-only transaction is cheaper on the database, it takes no write locks and no
+   * transaction id, and statements that would write fail.
+   * @example
+   * ```cpp
+   * // a consistent snapshot for several SELECT statements
+   * sqlClient.startTransaction(NeonReadOnly | NeonRepeatableRead);
+   * sqlClient.addQueryToTransaction("SELECT count(*) FROM sensorvalues");
+   * sqlClient.addQueryToTransaction("SELECT max(sent_time) FROM sensorvalues");
+   * const char* errorMessage = sqlClient.executeTransaction();
+   * ```
+   *
+   * @param options NeonTransactionOption flags, by default a read-write transaction with the
+   *                isolation level of the database
    */
-  void startTransaction() {
+  void startTransaction(uint8_t options = NeonDefaultTransaction) {
+    static_assert(Features::Transactions, "transactions need Features::Transactions");
+    JsonDocument& txnRequest = this->txnRequest();
     txnRequest.clear();
-    txnResponse.clear();
+    txnResponse().clear();
     txnRequest["queries"].to<JsonArray>();
+    for (size_t i = 0; i < Features::MaxTransactionQueryFilters; i++) {
+      txn.queryFilters[i] = nullptr;
+    }
+    txn.hasQueryFilters = false;
+    txn.options = options;
+  }
+
+  /**
+    * Keep only the parts of the transaction result selected by filter.
+    * The filter applies to the complete result, for example
+    * ```cpp
+    * filter["results"][0]["rows"] = true;
+    * ```
+    * keeps only the rows of every query in the transaction.
+    *
+    * @param filter ArduinoJson filter document, nullptr to keep the complete result.
+    *               This pointer must be valid while it is set, it is NOT copied
+    */
+  void setTransactionResponseFilter(const JsonDocument* filter) {
+    txn.responseFilter = filter;
+  }
+
+  /**
+    * Keep only the parts of the result of one query in the transaction selected by filter.
+    * Overrides the filter set with setTransactionResponseFilter() for this query.
+    * Filters are reset by startTransaction().
+    * @example
+    * ```cpp
+    * JsonDocument rowCountOnly;
+    * rowCountOnly["rowCount"] = true;
+    * sqlClient.setFilterForTransactionQuery(0, &rowCountOnly);
+    * ```
+    *
+    * @param queryIndex 0-based index of the query in the transaction, less than Features::MaxTransactionQueryFilters
+    * @param filter ArduinoJson filter document applied to the result object of this query,
+    *               for example {"rows":true}. This pointer must be valid while it is set, it is NOT copied
+    *
+    * @return false if queryIndex is too large
+    */
+  bool setFilterForTransactionQuery(size_t queryIndex, const JsonDocument* filter) {
+    if (queryIndex >= Features::MaxTransactionQueryFilters) {
+      return false;
+    }
+    txn.queryFilters[queryIndex] = filter;
+    txn.hasQueryFilters = false;
+    for (size_t i = 0; i < Features::MaxTransactionQueryFilters; i++) {
+      txn.hasQueryFilters = txn.hasQueryFilters || txn.queryFilters[i] != nullptr;
+    }
+    return true;
   }
 
   /**
@@ -222,9 +1292,10 @@ public:
   const char* executeTransaction(unsigned long timeout = 20000) {
     // activate the following lines for debugging
     // Serial.println();
-    // serializeJson(txnRequest, Serial);
+    // serializeJson(txnRequest(), Serial);
     // Serial.println();
-    return executeInternal(txnRequest, txnResponse, timeout);
+    return executeInternal(transactionPayload(), txnResponse(), txn.memory, timeout, txn.responseFilter,
+                           txn.hasQueryFilters);
   }
 
   /**
@@ -235,6 +1306,7 @@ public:
     * @return the rows returned as JsonArray
     */
   JsonArray getRowsForTransactionQuery(size_t queryIndex) {
+    JsonDocument& txnResponse = this->txnResponse();
     if (queryIndex >= txnResponse["results"].size()) {
       return JsonArray();
     }
@@ -250,6 +1322,7 @@ public:
     * @return number of rows returned or affected
     */
   int getRowCountForTransactionQuery(size_t queryIndex) {
+    JsonDocument& txnResponse = this->txnResponse();
     if (queryIndex >= txnResponse["results"].size()) {
       return -1;
     }
@@ -257,18 +1330,32 @@ public:
   }
 
   JsonArray getFieldsForTransactionQuery(size_t queryIndex) {
+    JsonDocument& txnResponse = this->txnResponse();
     if (queryIndex >= txnResponse["results"].size()) {
       return JsonArray();
     }
     return txnResponse["results"][queryIndex]["fields"].as<JsonArray>();
   }
 
+  /**
+    * After execution of a transaction get the position of a column in the rows of a query
+    * returned in array mode, see setArrayMode().
+    *
+    * @param queryIndex 0-based index of the query in the transaction
+    * @param name column name as returned in getFieldsForTransactionQuery()
+    *
+    * @return 0-based index of the column in a row, -1 if there is no such column
+    */
+  int getColumnIndexForTransactionQuery(size_t queryIndex, const char* name) {
+    return findColumn(getFieldsForTransactionQuery(queryIndex), name);
+  }
+
   /** Get complete transaction result as ArduinoJson JsonDocument.
     * Mostly used for debugging, normally
     * getRowsForTransactionQuery(), getFieldsForTransactionQuery() and getRowCountForTransactionQuery() should be used.
     */
   JsonDocument& getRawJsonResultForTransaction() {
-    return txnResponse;
+    return txnResponse();
   }
 
   /** Print complete transaction result as ArduinoJson JsonDocument.
@@ -280,105 +1367,1876 @@ public:
     */
   void printRawJsonResultForTransaction(Print& print) {
     print.println();
-    serializeJson(txnResponse, print);
+    serializeJson(txnResponse(), print);
     print.println();
   }
 
+  // --------------------------------------------------------------------
+  // asynchronous execution
+  // allows to do other work in loop() while a statement is executed
+  // --------------------------------------------------------------------
+
+  /**
+    * Start executing the SQL statement set with setQuery() without waiting for the result.
+    * Call poll() repeatedly, for example from loop(), until it returns true. Each call does a
+    * bounded amount of work and returns without waiting for the network.
+    * Connecting to the proxy is done in a single poll() call, because the Wifi client libraries
+    * connect synchronously.
+    * Do not change the statement or its parameters until the request is done.
+    * The response body is collected in a heap buffer of its size and parsed when it is complete.
+    * @example
+    * ```cpp
+    * sqlClient.setQuery(insertSensorValue);
+    * ...
+    * sqlClient.executeAsync();
+    * ...
+    * void loop() {
+    *   readSensors();
+    *   if (sqlClient.poll()) {
+    *     const char* errorMessage = sqlClient.getAsyncError();
+    *     ...
+    *   }
+    * }
+    * ```
+    *
+    * @param timeout maximum time in milliseconds for the complete request
+    */
+  void executeAsync(unsigned long timeout = 20000) {
+    startAsync(request, response, responseMemory, timeout, responseFilter, false);
+  }
+
+  /**
+    * Start executing a prepared statement without waiting for the result, see executeAsync() and
+    * execute(NeonPreparedStatement&). Do not change its parameters until poll() returned true.
+    *
+    * @param statement the prepared statement
+    * @param timeout maximum time in milliseconds for the complete request
+    */
+  void executeAsync(NeonPreparedStatement& statement, unsigned long timeout = 20000) {
+    if (!statement.isPrepared()) {
+      abandonPendingRequest();
+      errorKind = NeonRequestError;
+      asyncError = "statement is not prepared";
+      asyncState = AsyncDone;
+      return;
+    }
+    startAsync(statement, response, responseMemory, timeout, responseFilter, false);
+  }
+
+  /**
+    * Start executing the transaction built with addQueryToTransaction() without waiting for the result,
+    * see executeAsync().
+    *
+    * @param timeout maximum time in milliseconds for the complete request
+    */
+  void executeTransactionAsync(unsigned long timeout = 20000) {
+    startAsync(transactionPayload(), txnResponse(), txn.memory, timeout, txn.responseFilter, txn.hasQueryFilters);
+  }
+
+  /**
+    * Advance the request started with executeAsync() or executeTransactionAsync().
+    *
+    * @return true if the request is done (or no request was started), false while it is in progress
+    */
+  bool poll() {
+    switch (asyncState) {
+      case AsyncIdle:
+      case AsyncDone:
+        return true;
+      case AsyncConnecting:
+        pollConnecting();
+        break;
+      case AsyncSending:
+        pollSending();
+        break;
+      case AsyncHead:
+        pollHead();
+        break;
+      case AsyncBody:
+        pollBody();
+        break;
+    }
+    if (asyncState != AsyncDone && millis() - asyncStart >= asyncTimeout) {
+      errorKind = asyncState == AsyncConnecting ? NeonConnectError : NeonTimeoutError;
+      finishAsync("query timed out");
+    }
+    return asyncState == AsyncDone;
+  }
+
+  /**
+    * @return true if no asynchronous request is in progress
+    */
+  bool isDone() {
+    return asyncState == AsyncIdle || asyncState == AsyncDone;
+  }
+
+  /**
+    * After poll() returned true get the outcome of the asynchronous request.
+    * The result is available with the same methods as after execute() or executeTransaction().
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* getAsyncError() {
+    return asyncError;
+  }
+
+  /**
+    * Retry failed requests of execute() and executeTransaction() with exponential backoff and jitter, and stop
+    * sending requests for a while after repeated failures (circuit breaker).
+    * Requests that failed to connect are always retried, requests that timed out or got an invalid response or a
+    * server error are only retried after setIdempotent(true), because the statement may already have been executed.
+    * SQL errors are not retried, except serialization failures and deadlocks that rolled the transaction back.
+    * While the breaker is open all requests, also asynchronous ones, fail immediately with "circuit breaker open"
+    * without using the network. After breakerCooldown the next request is sent as probe, if it succeeds the breaker
+    * closes, otherwise it stays open for another breakerCooldown.
+    * @example
+    * ```cpp
+    * NeonRetryPolicy policy;
+    * policy.maxAttempts = 4;          // first attempt and up to 3 retries
+    * policy.initialBackoff = 500;     // 0.25 - 0.5 s, 0.5 - 1 s, 1 - 2 s
+    * policy.maxBackoff = 8000;
+    * policy.breakerThreshold = 5;     // open after 5 failed requests in a row
+    * policy.breakerCooldown = 60000;  // then fail fast for a minute
+    * sqlClient.setRetryPolicy(policy);
+    * ```
+    *
+    * @param policy the policy, it is copied
+    */
+  void setRetryPolicy(const NeonRetryPolicy& policy) {
+    retryPolicy = policy;
+    if (retryPolicy.maxAttempts == 0) {
+      retryPolicy.maxAttempts = 1;
+    }
+  }
+
+  /**
+    * Declare whether the statements executed from now on can safely be executed twice, for example SELECTs or
+    * INSERTs with ON CONFLICT DO NOTHING. Only then requests whose outcome is unknown are retried.
+    *
+    * @param idempotent true if executing the statements again has no additional effect
+    */
+  void setIdempotent(bool idempotent) {
+    this->idempotent = idempotent;
+  }
+
+  /**
+    * @return the classification of the error of the last request, NeonNoError after success
+    */
+  NeonErrorKind getLastErrorKind() {
+    return errorKind;
+  }
+
+  // true while the circuit breaker lets no requests through
+  bool isCircuitOpen() {
+    return breakerOpen && millis() - breakerOpenedAt < retryPolicy.breakerCooldown;
+  }
+
+  /**
+    * Limit the memory of the result of execute(), executeAsync() and executeCursor(), including the temporary
+    * documents used while parsing and the buffer of executeAsync(). A result that needs more fails with
+    * "result exceeds the memory budget" instead of "NoMemory" or exhausting the heap, the rest of it is skipped
+    * and a kept-alive connection stays usable. getMemoryBudgetError() tells how much would have been needed.
+    * @example
+    * ```cpp
+    * sqlClient.setMemoryBudget(16384);
+    * const char* errorMessage = sqlClient.execute();
+    * const NeonMemoryBudgetError* budgetError = sqlClient.getMemoryBudgetError();
+    * if (budgetError != nullptr) {
+    *   Serial.println(budgetError->bytesNeeded);
+    * }
+    * ```
+    *
+    * @param bytes the budget in bytes, 0 for no limit
+    */
+  void setMemoryBudget(size_t bytes) {
+    responseMemory.setLimit(bytes);
+  }
+
+  /**
+    * Like setMemoryBudget() for the result of executeTransaction() and executeTransactionAsync().
+    *
+    * @param bytes the budget in bytes, 0 for no limit
+    */
+  void setTransactionMemoryBudget(size_t bytes) {
+    static_assert(Features::Transactions, "transactions need Features::Transactions");
+    txn.memory.setLimit(bytes);
+  }
+
+  /**
+    * Peak memory of the result of the last execute(), executeAsync() or executeCursor(), including the temporary
+    * documents used while parsing. Use it to choose a memory budget or the size of a NeonArenaAllocator.
+    */
+  size_t getPeakMemory() {
+    return responseMemory.getPeak();
+  }
+
+  /**
+    * Like getPeakMemory() for the last transaction.
+    */
+  size_t getPeakMemoryForTransaction() {
+    static_assert(Features::Transactions, "transactions need Features::Transactions");
+    return txn.memory.getPeak();
+  }
+
+  /**
+    * @return details if the last request failed because its result exceeded the memory budget, nullptr otherwise
+    */
+  const NeonMemoryBudgetError* getMemoryBudgetError() {
+    return budgetExceeded ? &budgetError : nullptr;
+  }
+
+  /**
+    * The SQL error of the last request. SQL errors are parsed into this fixed structure instead of the
+    * result document, without allocating memory, so the result of the previous successful request
+    * stays available with getRows() and getRawJsonResult().
+    * @example
+    * ```cpp
+    * const char* errorMessage = sqlClient.execute();
+    * const NeonSqlErrorDetails* sqlError = sqlClient.getSqlError();
+    * if (sqlError != nullptr && strcmp(sqlError->code, "23505") == 0) {
+    *   // the row exists already
+    * }
+    * ```
+    *
+    * @return details if the last request failed with an SQL error, nullptr otherwise
+    */
+  const NeonSqlErrorDetails* getSqlError() {
+    return sqlErrorParsed ? &sqlErrorDetails : nullptr;
+  }
+
+  /**
+    * Duration of the phases and size of the last completed request, only available with
+    * Features::Instrumentation. For NeonPostgresOverHTTPProxyClient define NEON_POSTGRES_INSTRUMENTATION
+    * before including this header.
+    * @example
+    * ```cpp
+    * #define NEON_POSTGRES_INSTRUMENTATION
+    * #include <NeonPostgresOverHTTP.h>
+    * ...
+    * sqlClient.execute();
+    * const NeonRequestTimings& timings = sqlClient.getLastTimings();
+    * Serial.println(timings.waitMicros);
+    * ```
+    */
+  const NeonRequestTimings& getLastTimings() {
+    static_assert(Features::Instrumentation, "getLastTimings() needs Features::Instrumentation");
+    return instrumentation.lastTimings;
+  }
+
+  /**
+    * Counters accumulated over all requests, only available with Features::Instrumentation.
+    */
+  const NeonRequestCounters& getCounters() {
+    static_assert(Features::Instrumentation, "getCounters() needs Features::Instrumentation");
+    return instrumentation.counters;
+  }
+
+  /**
+    * Estimate a percentile of the request latency from the histogram of the counters.
+    *
+    * @param percent the percentile, for example 50 or 99
+    *
+    * @return upper bound in milliseconds of the histogram bucket that contains the percentile, 0 without requests
+    */
+  unsigned long getLatencyPercentile(uint8_t percent) {
+    static_assert(Features::Instrumentation, "getLatencyPercentile() needs Features::Instrumentation");
+    return instrumentation.latencyPercentile(percent);
+  }
+
+  void resetCounters() {
+    static_assert(Features::Instrumentation, "resetCounters() needs Features::Instrumentation");
+    memset(&instrumentation.counters, 0, sizeof(instrumentation.counters));
+  }
+
 private:
 
+  /**
+    * Json payload of a request, either a JsonDocument or a prepared statement with its parameters.
+    */
+  struct RequestPayload {
+    RequestPayload() {}
+    RequestPayload(JsonDocument& json) : json(&json) {}
+    RequestPayload(NeonPreparedStatement& statement) : statement(&statement) {}
+
+    size_t measure() const {
+      return statement != nullptr ? statement->measure() : measureJson(*json);
+    }
+
+    size_t writeTo(Print& out) const {
+      return statement != nullptr ? statement->writeTo(out) : serializeJson(*json, out);
+    }
+
+    JsonDocument* json = nullptr;
+    NeonPreparedStatement* statement = nullptr;
+    // NeonTransactionOption flags of a transaction
+    uint8_t transactionOptions = NeonDefaultTransaction;
+  };
+
+  // a string that ArduinoJson stores by pointer, the API changed with ArduinoJson 7.3
+  static JsonString staticText(const char* text) {
+#if ARDUINOJSON_VERSION_MAJOR == 7 && ARDUINOJSON_VERSION_MINOR < 3
+    return JsonString(text, JsonString::Linked);
+#else
+    return JsonString(text, true);
+#endif
+  }
+
+  RequestPayload transactionPayload() {
+    RequestPayload payload(txnRequest());
+    payload.transactionOptions = txn.options;
+    return payload;
+  }
+
+  // the transaction documents, only instantiated by the transaction methods
+  JsonDocument& txnRequest() {
+    return txn.request;
+  }
+
+  JsonDocument& txnResponse() {
+    return txn.response;
+  }
+
+  // a constant false without Features::KeepAlive, so the code for reused connections is left out
+  bool keepAliveEnabled() const {
+    return Features::KeepAlive && keepAlive;
+  }
+
+  // the result of the next request is parsed with memory, it counts the peak and enforces the budget
+  void startResult(NeonTrackingAllocator& memory) {
+    resultMemory = &memory;
+    memory.resetPeak();
+    budgetExceeded = false;
+    sqlErrorParsed = false;
+    errorKind = NeonNoError;
+  }
+
+  // instrumentation hooks, they are empty without Features::Instrumentation
+  void instrumentStart() {
+    instrumentation.start(input.received);
+  }
+
+  // add the time since the end of the previous phase to a phase
+  void instrumentPhase(unsigned long NeonRequestTimings::*phase) {
+    instrumentation.phase(phase);
+  }
+
+  void instrumentConnect() {
+    instrumentation.connect();
+  }
+
+  void instrumentRetry() {
+    instrumentation.retry();
+  }
+
+  void instrumentSent(size_t bytes) {
+    instrumentation.sent(bytes);
+  }
+
+  void instrumentEnd(const char* errorMessage) {
+    instrumentation.end(errorMessage, input.received, resultMemory->getPeak());
+  }
+
   /**
     * Connect to proxy, send the SQL statement(s) parse the result.
     * 
-    * @param src JsonDocument containing the queries
+    * @param src payload containing the queries
     * @param dst JsonDocument to store the result
+    * @param memory the tracking allocator of dst
     * @param timeout maximum time in milliseconds to wait for response
+    * @param filter ArduinoJson filter for the result, nullptr to keep the complete result
+    * @param filterPerQuery true to apply the filters set with setFilterForTransactionQuery()
     *
     * @return nullptr on success, error message in case of failure
     */
-  const char* executeInternal(JsonDocument& src, JsonDocument& dst, unsigned long timeout = 20000) {
-    if (client.connect(proxy, proxyPort)) {
-      client.println("POST /sql HTTP/1.1");
-      client.print("Host: ");
-      client.println(proxy);
-      client.print("Neon-Connection-String: ");
-      client.println(connstr);
-      client.println("Content-Type: application/json");
-      client.print("Content-Length: ");
-      size_t length = measureJson(src);
-      client.print(length);
-      // Send payload after second new-line
-      client.print("\r\n\r\n");  // double new line between headers and payload
-
-      size_t written = serializeJson(src, client);
-      if (written != length) {
-        // Serial.print("Writing ");
-        // Serial.print(length);
-        // Serial.println(" chars:\n");
-        // serializeJson(request, Serial);
-        // Serial.print("\nserializeJson written: ");
-        // Serial.println(written);
-        client.stop();
-        return "payload serialization error";
-      }
-      client.flush();
-      // waiting for response
-      unsigned long ms = millis();
-      while (!client.available() && millis() - ms < timeout) {
-        delay(0);
-      }
-      if (client.available()) {
-        // Check HTTP status
-        size_t bytes_read = client.readBytesUntil('\r', status, sizeof(status) - 1);
-        status[bytes_read] = 0;
-        // It should be "HTTP/1.0 200 OK" or "HTTP/1.1 200 OK" or HTTP/1.1 400 Bad Request
-        int status_code;
-        sscanf(status + 9, "%3d", &status_code);
-        if (status_code < 200 || (status_code >= 300 && status_code < 400) || status_code > 400) {
-          client.stop();
-          return status;
-        }
-        // Skip HTTP headers
-        char endOfHeaders[] = "\r\n\r\n";
-        if (!client.find(endOfHeaders)) {
-          client.stop();
-          return "Invalid response";
-        }
-
-        DeserializationError err = deserializeJson(dst, client);
-        if (err) {
-          client.stop();
-          return err.c_str();
-        }
-        // else {
-        //   Serial.println();
-        //   serializeJson(response, Serial);
-        //   Serial.println();
-        // }
-        client.stop();
-        const char* errormessage = dst["message"];
-        if (errormessage != nullptr) {
-          return errormessage;
-        }
-      } else {
-        client.stop();
-        return "query timed out";
+  const char* executeInternal(RequestPayload src, JsonDocument& dst, NeonTrackingAllocator& memory, unsigned long timeout = 20000,
+                              const JsonDocument* filter = nullptr, bool filterPerQuery = false) {
+    unsigned long backoff = retryPolicy.initialBackoff;
+    for (uint8_t attempt = 1;; attempt++) {
+      const char* errorMessage = beginRequest(src, memory, timeout);
+      if (errorMessage == nullptr) {
+        errorMessage = parseResponse(dst, filter, filterPerQuery);
       }
+      errorMessage = endRequest(errorMessage, dst);
+      if (errorMessage == nullptr || attempt >= retryPolicy.maxAttempts || !retryable() || isCircuitOpen()) {
+        return errorMessage;
+      }
+      // equal jitter: wait between half and all of the backoff, so that a fleet does not retry in lockstep
+      delay(backoff / 2 + random(backoff / 2 + 1));
+      backoff = backoff < retryPolicy.maxBackoff / 2 ? backoff * 2 : retryPolicy.maxBackoff;
+    }
+  }
+
+  bool retryable() {
+    switch (errorKind) {
+      case NeonConnectError:
+      case NeonSqlRetryableError:
+        return true;
+      case NeonTimeoutError:
+      case NeonServerError:
+      case NeonResponseError:
+        return idempotent;
+      default:
+        return false;
+    }
+  }
+
+  // classify the error of a finished request and update the circuit breaker
+  void recordOutcome(const char* errorMessage, bool sqlError) {
+    if (errorKind == NeonCircuitOpenError) {
+      return;
+    }
+    if (errorMessage == nullptr) {
+      errorKind = NeonNoError;
+    } else if (errorKind != NeonNoError) {
+      // classified where it happened
+    } else if (sqlError) {
+      const char* code = sqlErrorDetails.code;
+      bool rolledBack = strcmp(code, "40001") == 0 || strcmp(code, "40P01") == 0;
+      errorKind = rolledBack ? NeonSqlRetryableError : NeonSqlError;
+    } else if (budgetExceeded || strcmp(errorMessage, "NoMemory") == 0) {
+      errorKind = NeonMemoryError;
+    } else if (statusCode >= 500) {
+      errorKind = NeonServerError;
+    } else if (errorMessage == status) {
+      errorKind = NeonHttpError;
     } else {
-      // client.stop();
-      return "cannot connect to proxy over Wifi";
+      errorKind = NeonResponseError;
+    }
+    bool proxyUnavailable = errorKind == NeonConnectError || errorKind == NeonTimeoutError
+                            || errorKind == NeonServerError || errorKind == NeonResponseError;
+    if (!proxyUnavailable) {
+      consecutiveFailures = 0;
+      breakerOpen = false;
+      return;
+    }
+    if (consecutiveFailures < 255) {
+      consecutiveFailures++;
+    }
+    if (retryPolicy.breakerThreshold > 0 && (breakerOpen || consecutiveFailures >= retryPolicy.breakerThreshold)) {
+      // a failed probe keeps the breaker open for another cooldown
+      breakerOpen = true;
+      breakerOpenedAt = millis();
     }
-    return nullptr;
   }
 
-  JsonDocument request;
-  JsonDocument response;
-  JsonDocument txnRequest;
-  JsonDocument txnResponse;
-  WiFiClient& client;
-  const char* connstr;
-  const char* proxy;
-  const int proxyPort;
-  char status[32];
-};
+  // parse the body into dst, or into sqlErrorDetails for an SQL error
+  const char* parseResponse(JsonDocument& dst, const JsonDocument* filter, bool filterPerQuery) {
+    return statusCode == 400 ? parseSqlError() : parseBody(dst, filter, filterPerQuery);
+  }
+
+  /**
+    * Read the SQL error object of a response with status 400 into sqlErrorDetails, keeping only message,
+    * code, detail and position. Reads the body character by character without allocating memory.
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* parseSqlError() {
+    NeonSqlErrorDetails& details = sqlErrorDetails;
+    details.message[0] = 0;
+    details.code[0] = 0;
+    details.detail[0] = 0;
+    details.position = 0;
+    if (body.readNonWhitespace() != '{') {
+      return "Invalid response";
+    }
+    int c = body.readNonWhitespace();
+    while (c == '"') {
+      // longer keys are truncated and match none of the keys we keep
+      char key[10];
+      if (!readJsonString(key, sizeof(key)) || body.readNonWhitespace() != ':') {
+        return "Invalid response";
+      }
+      char position[8];
+      char* target = nullptr;
+      size_t size = 0;
+      if (strcmp(key, "message") == 0) {
+        target = details.message;
+        size = sizeof(details.message);
+      } else if (strcmp(key, "code") == 0) {
+        target = details.code;
+        size = sizeof(details.code);
+      } else if (strcmp(key, "detail") == 0) {
+        target = details.detail;
+        size = sizeof(details.detail);
+      } else if (strcmp(key, "position") == 0) {
+        target = position;
+        size = sizeof(position);
+      }
+      if (!readJsonValue(target, size)) {
+        return "Invalid response";
+      }
+      if (target == position) {
+        details.position = atoi(position);
+      }
+      c = body.readNonWhitespace();
+      if (c != ',') {
+        break;
+      }
+      c = body.readNonWhitespace();
+    }
+    if (c != '}') {
+      return "Invalid response";
+    }
+    sqlErrorParsed = true;
+    return nullptr;
+  }
+
+  /**
+    * Read the rest of a Json string after its opening quote into target, truncated to size - 1 characters.
+    * Escapes are decoded, \u escapes outside of ASCII become '?'.
+    *
+    * @param target buffer for the string, nullptr to skip it
+    *
+    * @return false if the body ended before the string
+    */
+  bool readJsonString(char* target, size_t size) {
+    size_t n = 0;
+    while (true) {
+      int c = body.read();
+      if (c < 0) {
+        return false;
+      }
+      if (c == '"') {
+        break;
+      }
+      if (c == '\\') {
+        c = body.read();
+        switch (c) {
+          case 'b': c = '\b'; break;
+          case 'f': c = '\f'; break;
+          case 'n': c = '\n'; break;
+          case 'r': c = '\r'; break;
+          case 't': c = '\t'; break;
+          case 'u': {
+            char hex[5] = {};
+            if (body.readBytes(hex, 4) != 4) {
+              return false;
+            }
+            long code = strtol(hex, nullptr, 16);
+            c = code < 0x80 ? static_cast<int>(code) : '?';
+            break;
+          }
+          default:
+            // \" \\ \/ stand for themselves
+            if (c < 0) {
+              return false;
+            }
+        }
+      }
+      if (target != nullptr && n + 1 < size) {
+        target[n++] = static_cast<char>(c);
+      }
+    }
+    if (target != nullptr) {
+      target[n] = 0;
+    }
+    return true;
+  }
+
+  /**
+    * Read a Json value of the SQL error object. A string or a number is kept in target,
+    * other values are skipped.
+    *
+    * @return false if the body ended before the value
+    */
+  bool readJsonValue(char* target, size_t size) {
+    int c = body.readNonWhitespace();
+    if (c == '"') {
+      return readJsonString(target, size);
+    }
+    size_t n = 0;
+    int depth = 0;
+    while (c >= 0) {
+      if (c == '"') {
+        if (!readJsonString(nullptr, 0)) {
+          return false;
+        }
+      } else if (c == '{' || c == '[') {
+        depth++;
+      } else if ((c == '}' || c == ']' || c == ',') && depth == 0) {
+        // the end of the value belongs to the object
+        body.unread();
+        break;
+      } else if (c == '}' || c == ']') {
+        depth--;
+      } else if (target != nullptr && depth == 0 && n + 1 < size && c > ' ') {
+        target[n++] = static_cast<char>(c);
+      }
+      c = body.read();
+    }
+    if (target != nullptr) {
+      target[n] = 0;
+    }
+    return c >= 0;
+  }
+
+  /**
+    * Parse the response body into dst.
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* parseBody(JsonDocument& dst, const JsonDocument* filter, bool filterPerQuery) {
+    if (filterPerQuery) {
+      return parseTransactionResults(dst, filter);
+    }
+    DeserializationError err = filter != nullptr ? deserializeJson(dst, body, DeserializationOption::Filter(*filter))
+                                                 : deserializeJson(dst, body);
+    if (err) {
+      return err.c_str();
+    }
+    // else {
+    //   Serial.println();
+    //   serializeJson(response, Serial);
+    //   Serial.println();
+    // }
+    return nullptr;
+  }
+
+  /**
+    * Connect to proxy (or reuse the kept-alive connection), send the request and read the
+    * response up to the start of the body, which can then be read through body.
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* beginRequest(RequestPayload src, NeonTrackingAllocator& memory, unsigned long timeout) {
+    abandonPendingRequest();
+    startResult(memory);
+    instrumentStart();
+    if (isCircuitOpen()) {
+      errorKind = NeonCircuitOpenError;
+      return "circuit breaker open";
+    }
+    bool reused = false;
+    const char* errorMessage = openConnection(reused);
+    if (errorMessage == nullptr) {
+      errorMessage = sendRequestReadHead(src, timeout);
+      if (errorMessage != nullptr && reused && staleConnection) {
+        // the proxy closed the idle connection before we noticed, retry once on a new connection
+        instrumentRetry();
+        closeConnection();
+        errorMessage = openConnection(reused);
+        if (errorMessage == nullptr) {
+          errorMessage = sendRequestReadHead(src, timeout);
+        }
+      }
+    }
+    return errorMessage;
+  }
+
+  void startAsync(RequestPayload src, JsonDocument& dst, NeonTrackingAllocator& memory, unsigned long timeout,
+                  const JsonDocument* filter, bool filterPerQuery) {
+    abandonPendingRequest();
+    startResult(memory);
+    asyncSrc = src;
+    asyncDst = &dst;
+    asyncFilter = filter;
+    asyncPerQuery = filterPerQuery;
+    asyncTimeout = timeout;
+    asyncStart = millis();
+    asyncError = nullptr;
+    asyncState = AsyncConnecting;
+    instrumentStart();
+    if (isCircuitOpen()) {
+      errorKind = NeonCircuitOpenError;
+      finishAsync("circuit breaker open");
+    }
+  }
+
+  void pollConnecting() {
+    bool reused = false;
+    const char* errorMessage = openConnection(reused);
+    if (errorMessage != nullptr) {
+      finishAsync(errorMessage);
+      return;
+    }
+    asyncReused = reused;
+    asyncState = AsyncSending;
+  }
+
+  void pollSending() {
+    const char* errorMessage = sendRequest(asyncSrc);
+    if (errorMessage != nullptr) {
+      retryOrFinishAsync(errorMessage);
+      return;
+    }
+    asyncReceived = false;
+    startHead();
+    asyncState = AsyncHead;
+  }
+
+  // read the status line and headers as far as they have been received
+  void pollHead() {
+    while (input.available() > 0) {
+      int c = input.read();
+      if (c < 0) {
+        break;
+      }
+      asyncReceived = true;
+      const char* errorMessage = parseHead(c);
+      if (errorMessage != nullptr) {
+        finishAsync(errorMessage);
+        return;
+      }
+      if (headDone) {
+        startAsyncBody();
+        return;
+      }
+    }
+    if (input.available() <= 0 && !client.connected()) {
+      if (!asyncReceived) {
+        staleConnection = true;
+        errorKind = NeonTimeoutError;
+        retryOrFinishAsync("query timed out");
+      } else {
+        finishAsync("Invalid response");
+      }
+    }
+  }
+
+  void startAsyncBody() {
+    // free the previous result first, so that an arena allocator is reset before the buffer is allocated,
+    // an SQL error leaves it untouched
+    if (statusCode != 400) {
+      asyncDst->clear();
+    }
+    startBody();
+    asyncChunks.reset();
+    asyncBodyLength = 0;
+    asyncBodyCapacity = !chunked && contentLength != SIZE_MAX ? contentLength : 0;
+    if (asyncBodyCapacity > 0) {
+      asyncBody = static_cast<char*>(resultMemory->allocate(asyncBodyCapacity));
+      if (asyncBody == nullptr) {
+        abortAsyncBody();
+        return;
+      }
+    }
+    asyncState = AsyncBody;
+    pollBody();
+  }
+
+  // collect the body as far as it has been received, parse it once it is complete
+  void pollBody() {
+    if (chunked) {
+      pollChunkedBody();
+      return;
+    }
+    while (input.available() > 0) {
+      if (asyncBodyLength == asyncBodyCapacity) {
+        if (contentLength != SIZE_MAX) {
+          break;
+        }
+        // without Content-Length the body ends when the proxy closes the connection
+        if (!growAsyncBody(256)) {
+          return;
+        }
+      }
+      size_t n = input.readAvailable(asyncBody + asyncBodyLength, asyncBodyCapacity - asyncBodyLength);
+      if (n == 0) {
+        break;
+      }
+      asyncBodyLength += n;
+    }
+    bool ended = input.available() <= 0 && !client.connected();
+    if (contentLength != SIZE_MAX && asyncBodyLength < contentLength) {
+      if (ended) {
+        finishAsync("Invalid response");
+      }
+      return;
+    }
+    if (contentLength == SIZE_MAX && !ended) {
+      return;
+    }
+    body.resetMemory(asyncBody, asyncBodyLength);
+    finishAsync(parseResponse(*asyncDst, asyncFilter, asyncPerQuery));
+  }
+
+  // collect the data of the chunks as far as they have been received, the buffer grows chunk by chunk
+  void pollChunkedBody() {
+    while (input.available() > 0 && asyncChunks.state != ChunkDecoder::Done) {
+      if (asyncChunks.state == ChunkDecoder::Data) {
+        if (asyncBodyLength == asyncBodyCapacity && !growAsyncBody(asyncChunks.dataLeft)) {
+          return;
+        }
+        size_t wanted = asyncBodyCapacity - asyncBodyLength;
+        if (wanted > asyncChunks.dataLeft) {
+          wanted = asyncChunks.dataLeft;
+        }
+        size_t n = input.readAvailable(asyncBody + asyncBodyLength, wanted);
+        asyncChunks.consumed(n);
+        asyncBodyLength += n;
+      } else if (!asyncChunks.frame(input.read())) {
+        finishAsync("Invalid response");
+        return;
+      }
+    }
+    if (asyncChunks.state != ChunkDecoder::Done) {
+      if (input.available() <= 0 && !client.connected()) {
+        finishAsync("Invalid response");
+      }
+      return;
+    }
+    body.resetMemory(asyncBody, asyncBodyLength);
+    finishAsync(parseResponse(*asyncDst, asyncFilter, asyncPerQuery));
+  }
+
+  bool growAsyncBody(size_t bytes) {
+    char* grown = static_cast<char*>(resultMemory->reallocate(asyncBody, asyncBodyCapacity + bytes));
+    if (grown == nullptr) {
+      abortAsyncBody();
+      return false;
+    }
+    asyncBody = grown;
+    asyncBodyCapacity += bytes;
+    return true;
+  }
+
+  // the body does not fit into memory, the rest of it cannot be skipped without blocking so the connection is closed
+  void abortAsyncBody() {
+    closeConnection();
+    body.resetMemory(nullptr, 0);
+    finishAsync("response does not fit into memory");
+  }
+
+  // repeat the request on a new connection if the reused connection had been closed by the proxy
+  void retryOrFinishAsync(const char* errorMessage) {
+    if (asyncReused && staleConnection) {
+      instrumentRetry();
+      closeConnection();
+      asyncReused = false;
+      asyncState = AsyncConnecting;
+      return;
+    }
+    finishAsync(errorMessage);
+  }
+
+  void finishAsync(const char* errorMessage) {
+    asyncError = endRequest(errorMessage, *asyncDst);
+    freeAsyncBody();
+    asyncState = AsyncDone;
+  }
+
+  void freeAsyncBody() {
+    if (asyncBody != nullptr) {
+      resultMemory->deallocate(asyncBody);
+    }
+    asyncBody = nullptr;
+    asyncBodyLength = 0;
+    asyncBodyCapacity = 0;
+  }
+
+  // close the connection if an unfinished cursor or asynchronous request is still using it
+  void abandonPendingRequest() {
+    if (cursorOpen) {
+      // the rest of the previous result was not read, it cannot be skipped cheaply
+      cursorOpen = false;
+      cursorInRows = false;
+      closeConnection();
+    }
+    if (asyncState != AsyncIdle && asyncState != AsyncDone) {
+      freeAsyncBody();
+      asyncState = AsyncIdle;
+      closeConnection();
+    }
+  }
+
+  /**
+    * Finish a request: skip what is left of the body and close or keep the connection.
+    *
+    * @param errorMessage error of the request so far, nullptr if it succeeded
+    * @param dst JsonDocument containing the result
+    *
+    * @return errorMessage, or the SQL error returned by the proxy, nullptr on success
+    */
+  const char* endRequest(const char* errorMessage, JsonDocument& dst) {
+    if (errorMessage != nullptr && resultMemory->getRefused() > 0) {
+      budgetExceeded = true;
+      budgetError.bytesNeeded = resultMemory->getRefused();
+      budgetError.budget = resultMemory->getLimit();
+      budgetError.rowsParsed = countRows(dst);
+      errorMessage = "result exceeds the memory budget";
+    }
+    // consume trailing bytes of the body so the next response starts at its status line,
+    // a result that exceeded the budget is skipped and the connection can still be reused
+    if ((errorMessage != nullptr && !budgetExceeded) || !keepAliveEnabled() || !responseKeepAlive || !body.drain()) {
+      closeConnection();
+    } else {
+      lastActivity = millis();
+    }
+    instrumentPhase(&NeonRequestTimings::parseMicros);
+    bool sqlError = false;
+    if (errorMessage == nullptr && sqlErrorParsed) {
+      errorMessage = sqlErrorDetails.message[0] != 0 ? sqlErrorDetails.message : "SQL error";
+      sqlError = true;
+    }
+    recordOutcome(errorMessage, sqlError);
+    instrumentEnd(errorMessage);
+    return errorMessage;
+  }
+
+  /**
+    * Reuse the kept-alive connection if it is still usable, otherwise connect to the proxy.
+    *
+    * @param reused set to true if an already open connection is reused
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* openConnection(bool& reused) {
+    reused = false;
+    if (connectionOpen) {
+      if (keepAliveEnabled() && client.connected() && millis() - lastActivity < idleTimeout) {
+        reused = true;
+        return nullptr;
+      }
+      closeConnection();
+    }
+    instrumentConnect();
+    if (tlsSessionCache != nullptr) {
+      tlsSessionCache->beforeConnect(client);
+    }
+    bool connected = resolver != nullptr ? connectByAddress() : client.connect(proxy, proxyPort);
+    if (tlsSessionCache != nullptr) {
+      tlsSessionCache->afterConnect(client, connected);
+    }
+    instrumentPhase(&NeonRequestTimings::connectMicros);
+    if (!connected) {
+      errorKind = NeonConnectError;
+      return "cannot connect to proxy over Wifi";
+    }
+    connectionOpen = true;
+    return nullptr;
+  }
+
+  // connect to the cached address of the proxy, resolve it if the cache is empty, expired or the address is not reachable
+  bool connectByAddress() {
+    bool fresh = false;
+    if (!resolved || millis() - resolvedAt >= resolveTtl) {
+      if (!resolve()) {
+        return client.connect(proxy, proxyPort);
+      }
+      fresh = true;
+    }
+    if (connectTo(resolvedIp)) {
+      return true;
+    }
+    if (fresh) {
+      return false;
+    }
+    // the proxy may have moved to another address
+    if (!resolve()) {
+      return client.connect(proxy, proxyPort);
+    }
+    return connectTo(resolvedIp);
+  }
+
+  bool resolve() {
+    resolved = resolver(proxy, resolvedIp) == 1;
+    resolvedAt = millis();
+    instrumentPhase(&NeonRequestTimings::resolveMicros);
+    return resolved;
+  }
+
+  bool connectTo(const IPAddress& ip) {
+    if (ipConnector != nullptr) {
+      return ipConnector(client, ip, proxyPort, proxy);
+    }
+    return client.connect(ip, proxyPort);
+  }
+
+  /**
+    * Send the HTTP request on the open connection and read the status line and headers.
+    * Sets staleConnection if nothing at all was received because the peer had already closed the
+    * connection, in that case the request can safely be repeated on a new connection.
+    *
+    * @return nullptr on success, error message in case of a transport or protocol failure
+    */
+  const char* sendRequestReadHead(RequestPayload src, unsigned long timeout) {
+    const char* errorMessage = sendRequest(src);
+    if (errorMessage != nullptr) {
+      return errorMessage;
+    }
+    return readHead(timeout);
+  }
+
+  /**
+    * Parse the response of one statement of executePipeline() into its result document or its sqlError.
+    *
+    * @return nullptr on success, the SQL error or why the result could not be parsed
+    */
+  const char* readPipelineResult(NeonPipelineStatement& statement) {
+    if (statusCode == 400) {
+      const char* errorMessage = parseSqlError();
+      if (errorMessage != nullptr) {
+        return errorMessage;
+      }
+      statement.sqlError = sqlErrorDetails;
+      return statement.sqlError.message[0] != 0 ? statement.sqlError.message : "SQL error";
+    }
+    return statement.result != nullptr ? parseBody(*statement.result, responseFilter, false) : nullptr;
+  }
+
+  /**
+    * Send the requests of all statements without waiting for a response, the connection is kept open
+    * after all but the last one, then read the status line and headers of the first response.
+    *
+    * @return nullptr on success, error message in case of a transport or protocol failure
+    */
+  const char* sendPipelineReadHead(NeonPipelineStatement* statements, size_t count, unsigned long timeout) {
+    for (size_t i = 0; i < count; i++) {
+      pipelineKeepOpen = i + 1 < count;
+      const char* errorMessage = sendRequest(*statements[i].statement);
+      pipelineKeepOpen = false;
+      if (errorMessage != nullptr) {
+        // the requests sent before are answered, but the connection cannot be trusted anymore
+        staleConnection = staleConnection && i == 0;
+        return errorMessage;
+      }
+    }
+    return readHead(timeout);
+  }
+
+  /**
+    * Wait for the next response on the open connection and read its status line and headers.
+    *
+    * @return nullptr on success, error message in case of a transport or protocol failure
+    */
+  const char* readHead(unsigned long timeout) {
+    const char* errorMessage = nullptr;
+    staleConnection = false;
+    responseKeepAlive = false;
+    statusCode = 0;
+    // waiting for response
+    unsigned long ms = millis();
+    while (input.available() <= 0 && client.connected() && millis() - ms < timeout) {
+      delay(0);
+    }
+    if (input.available() <= 0) {
+      staleConnection = !client.connected();
+      errorKind = NeonTimeoutError;
+      return "query timed out";
+    }
+    // status line and headers
+    startHead();
+    char c;
+    while (!headDone) {
+      if (input.readBytes(&c, 1) != 1) {
+        return "Invalid response";
+      }
+      errorMessage = parseHead(c);
+      if (errorMessage != nullptr) {
+        return errorMessage;
+      }
+    }
+    startBody();
+    return nullptr;
+  }
+
+  /**
+    * Send the HTTP request with the Json payload src on the open connection.
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* sendRequest(RequestPayload src) {
+    staleConnection = false;
+    responseKeepAlive = false;
+    statusCode = 0;
+    body.reset(0);
+    uint8_t stackBuffer[Features::WriteBufferSize];
+    RequestWriter writer(client, writeBuffer != nullptr ? writeBuffer : stackBuffer,
+                         writeBuffer != nullptr ? writeBufferSize : sizeof(stackBuffer));
+    writer.println("POST /sql HTTP/1.1");
+    writer.print("Host: ");
+    writer.println(proxy);
+    writer.print("Neon-Connection-String: ");
+    writer.println(connstr);
+    writer.println("Content-Type: application/json");
+    if (arrayMode) {
+      writer.println("Neon-Array-Mode: true");
+    }
+    writeTransactionOptions(writer, src.transactionOptions);
+    writer.println(keepAliveEnabled() || pipelineKeepOpen ? "Connection: keep-alive" : "Connection: close");
+    writer.print("Content-Length: ");
+    size_t length = src.measure();
+    writer.print(length);
+    // Send payload after second new-line
+    writer.print("\r\n\r\n");  // double new line between headers and payload
+
+    size_t written = src.writeTo(writer);
+    writer.sendBuffered();
+    instrumentSent(writer.sent);
+    instrumentPhase(&NeonRequestTimings::sendMicros);
+    if (written != length || writer.failed) {
+      // Serial.print("Writing ");
+      // Serial.print(length);
+      // Serial.println(" chars:\n");
+      // serializeJson(request, Serial);
+      // Serial.print("\nserializeJson written: ");
+      // Serial.println(written);
+      staleConnection = writer.sent == 0;
+      errorKind = writer.sent == 0 ? NeonConnectError : NeonTimeoutError;
+      return "payload serialization error";
+    }
+    client.flush();
+    return nullptr;
+  }
+
+  // the headers for the NeonTransactionOption flags of a transaction
+  static void writeTransactionOptions(Print& writer, uint8_t options) {
+    static const char* const levels[] = { "ReadCommitted", "RepeatableRead", "Serializable" };
+    uint8_t level = (options >> 2) & 3;
+    if (level > 0) {
+      writer.print("Neon-Batch-Isolation-Level: ");
+      writer.println(levels[level - 1]);
+    }
+    if (options & NeonReadOnly) {
+      writer.println("Neon-Batch-Read-Only: true");
+    }
+    if (options & NeonDeferrable) {
+      writer.println("Neon-Batch-Deferrable: true");
+    }
+  }
+
+  /**
+    * Check the HTTP status line read into status.
+    *
+    * @return nullptr if the body contains a result or an SQL error, the status line otherwise
+    */
+  const char* checkStatusLine() {
+    // It should be "HTTP/1.0 200 OK" or "HTTP/1.1 200 OK" or HTTP/1.1 400 Bad Request
+    int status_code = 0;
+    sscanf(status + 9, "%3d", &status_code);
+    statusCode = status_code;
+    if (status_code < 200 || (status_code >= 300 && status_code < 400) || status_code > 400) {
+      return status;
+    }
+    // HTTP/1.1 responses keep the connection open unless the proxy says otherwise
+    responseKeepAlive = strncmp(status, "HTTP/1.1", 8) == 0;
+    return nullptr;
+  }
+
+  // prepare body for reading the body announced by the headers
+  void startBody() {
+    instrumentPhase(&NeonRequestTimings::headMicros);
+    if (chunked) {
+      body.resetChunked();
+      return;
+    }
+    if (contentLength == SIZE_MAX) {
+      // without Content-Length the body ends when the proxy closes the connection
+      responseKeepAlive = false;
+    }
+    body.reset(contentLength);
+  }
+
+  /**
+    * Parse the members of the top level result object into dst one at a time, until the
+    * end of the object or until the array member arrayKey starts.
+    * Values of other members are small and deserialized as a whole.
+    *
+    * @param dst JsonDocument to store the members
+    * @param arrayKey name of the array member whose elements the caller reads one by one
+    * @param filter ArduinoJson filter for the result object, nullptr to keep all members
+    * @param afterMember true if a member has been parsed before and a ',' or '}' is expected next
+    * @param inArray set to true if the array arrayKey starts, false at the end of the object
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* scanResultMembers(JsonDocument& dst, const char* arrayKey, const JsonDocument* filter,
+                                bool afterMember, bool& inArray) {
+    inArray = false;
+    while (true) {
+      int c = body.readNonWhitespace();
+      if (afterMember) {
+        if (c == '}') {
+          return nullptr;
+        }
+        if (c != ',') {
+          return "Invalid response";
+        }
+        c = body.readNonWhitespace();
+      } else if (c == '}') {
+        return nullptr;
+      }
+      if (c != '"') {
+        return "Invalid response";
+      }
+      // member names of the result object are short and have no escapes
+      char key[16];
+      size_t len = 0;
+      while ((c = body.read()) != '"') {
+        if (c < 0) {
+          return "Invalid response";
+        }
+        if (len < sizeof(key) - 1) {
+          key[len++] = c;
+        }
+      }
+      key[len] = 0;
+      if (body.readNonWhitespace() != ':') {
+        return "Invalid response";
+      }
+      afterMember = true;
+      c = body.peekNonWhitespace();
+      if (strcmp(key, arrayKey) == 0 && c == '[') {
+        body.read();
+        if (body.peekNonWhitespace() == ']') {
+          body.read();  // empty array
+          continue;
+        }
+        inArray = true;
+        return nullptr;
+      }
+      JsonDocument value(resultMemory);
+      DeserializationError err = filter != nullptr
+                                   ? deserializeJson(value, body, DeserializationOption::Filter((*filter)[static_cast<const char*>(key)]))
+                                   : deserializeJson(value, body);
+      if (err) {
+        return err.c_str();
+      }
+      if (c == '-' || (c >= '0' && c <= '9')) {
+        // ArduinoJson consumed the character after the number to find its end
+        body.unread();
+      }
+      if (filter == nullptr || !value.isNull()) {
+        dst[static_cast<const char*>(key)] = value;
+      }
+    }
+  }
+
+  /**
+    * Parse a transaction result one query result at a time, so that each query can have its
+    * own filter set with setFilterForTransactionQuery().
+    *
+    * @param dst JsonDocument to store the result
+    * @param filter filter for the complete transaction result, used for queries without their own filter
+    *
+    * @return nullptr on success, error message in case of failure
+    */
+  const char* parseTransactionResults(JsonDocument& dst, const JsonDocument* filter) {
+    dst.clear();
+    if (body.readNonWhitespace() != '{') {
+      return "Invalid response";
+    }
+    bool inArray = false;
+    const char* errorMessage = scanResultMembers(dst, "results", filter, false, inArray);
+    JsonArray results;
+    if (inArray) {
+      results = dst["results"].to<JsonArray>();
+    }
+    for (size_t index = 0; errorMessage == nullptr && inArray; index++) {
+      const JsonDocument* queryFilter = txn.queryFilter(index);
+      JsonDocument result(resultMemory);
+      DeserializationError err;
+      if (queryFilter != nullptr) {
+        err = deserializeJson(result, body, DeserializationOption::Filter(*queryFilter));
+      } else if (filter != nullptr) {
+        err = deserializeJson(result, body, DeserializationOption::Filter(elementFilter((*filter)["results"])));
+      } else {
+        err = deserializeJson(result, body);
+      }
+      if (err) {
+        return err.c_str();
+      }
+      results.add(result);
+      int c = body.readNonWhitespace();
+      if (c == ']') {
+        errorMessage = scanResultMembers(dst, "results", filter, true, inArray);
+      } else if (c != ',') {
+        errorMessage = "Invalid response";
+      }
+    }
+    return errorMessage;
+  }
+
+  // rows of a result or of all queries of a transaction result
+  static size_t countRows(JsonDocument& result) {
+    JsonArray results = result["results"];
+    if (results.isNull()) {
+      return result["rows"].size();
+    }
+    size_t rows = 0;
+    for (JsonObject queryResult : results) {
+      rows += queryResult["rows"].size();
+    }
+    return rows;
+  }
+
+  static int findColumn(JsonArray fields, const char* name) {
+    int index = 0;
+    for (JsonObject field : fields) {
+      const char* fieldName = field["name"];
+      if (fieldName != nullptr && strcmp(fieldName, name) == 0) {
+        return index;
+      }
+      index++;
+    }
+    return -1;
+  }
+
+  // the filter ArduinoJson applies to the elements of an array with the given filter
+  static JsonVariantConst elementFilter(JsonVariantConst filter) {
+    return filter.is<JsonArrayConst>() ? filter[0] : filter;
+  }
+
+  /**
+    * Parse the rest of the result object after the rows array and finish the request.
+    */
+  void finishCursor(const char* errorMessage) {
+    cursorInRows = false;
+    if (errorMessage == nullptr) {
+      bool inArray = false;
+      errorMessage = scanResultMembers(response, "rows", cursorFilter, true, inArray);
+    }
+    cursorOpen = false;
+    cursorError = endRequest(errorMessage, response);
+  }
+
+  // prepare parsing the status line and headers of a new response
+  void startHead() {
+    headDone = false;
+    headStatusLine = true;
+    headLineLength = 0;
+    contentLength = SIZE_MAX;
+    chunked = false;
+    for (size_t i = 0; i < capturedHeaderCount; i++) {
+      capturedHeaders[i].received = false;
+    }
+  }
+
+  /**
+    * Parse the status line and headers one byte at a time, sets headDone at the empty line before the body.
+    * Lines longer than Features::ResponseLineSize are truncated, we are not interested in long header values.
+    *
+    * @return nullptr while the response is usable, error message otherwise
+    */
+  const char* parseHead(char c) {
+    if (headStatusLine && headLineLength == 0) {
+      instrumentPhase(&NeonRequestTimings::waitMicros);
+    }
+    if (c != '\n') {
+      if (headLineLength < sizeof(headLine) - 1) {
+        headLine[headLineLength++] = c;
+      }
+      return nullptr;
+    }
+    if (headLineLength > 0 && headLine[headLineLength - 1] == '\r') {
+      headLineLength--;
+    }
+    headLine[headLineLength] = 0;
+    size_t length = headLineLength;
+    headLineLength = 0;
+    if (headStatusLine) {
+      headStatusLine = false;
+      strncpy(status, headLine, sizeof(status) - 1);
+      status[sizeof(status) - 1] = 0;
+      return checkStatusLine();
+    }
+    if (length == 0) {
+      headDone = true;  // empty line between headers and body
+      return nullptr;
+    }
+    return processHeaderLine(headLine);
+  }
+
+  // pick up the response headers we are interested in, lines without a colon are ignored
+  const char* processHeaderLine(char* line) {
+    char* value = strchr(line, ':');
+    if (value == nullptr) {
+      return nullptr;
+    }
+    *value++ = 0;
+    while (*value == ' ' || *value == '\t') {
+      value++;
+    }
+    if (strcasecmp(line, "Content-Length") == 0) {
+      contentLength = strtoul(value, nullptr, 10);
+    } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+      chunked = strstr(value, "chunked") != nullptr;
+    } else if (strcasecmp(line, "Connection") == 0 && strstr(value, "close") != nullptr) {
+      responseKeepAlive = false;
+    }
+    for (size_t i = 0; i < capturedHeaderCount; i++) {
+      if (strcasecmp(line, capturedHeaders[i].name) == 0) {
+        strncpy(capturedHeaders[i].value, value, sizeof(capturedHeaders[i].value) - 1);
+        capturedHeaders[i].value[sizeof(capturedHeaders[i].value) - 1] = 0;
+        capturedHeaders[i].received = true;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+    * Follows the framing of a body sent with Transfer-Encoding: chunked.
+    * The bytes between the chunk data are passed to frame(), the chunk data themselves are
+    * read by the caller, at most dataLeft bytes, and reported with consumed().
+    */
+  struct ChunkDecoder {
+    enum State {
+      Size,
+      Extension,
+      Data,
+      DataEnd,
+      Trailer,
+      TrailerLine,
+      Done
+    };
+
+    void reset() {
+      state = Size;
+      dataLeft = 0;
+      sizeDigits = 0;
+    }
+
+    // consume one byte outside the chunk data, returns false if the framing is broken
+    bool frame(int c) {
+      switch (state) {
+        case Size:
+          if (c == '\n') {
+            return endSizeLine();
+          }
+          if (c == ';' || c == ' ' || c == '\t' || c == '\r') {
+            state = Extension;
+            return true;
+          }
+          if (sizeDigits == 2 * sizeof(size_t)) {
+            return false;
+          }
+          if (c >= '0' && c <= '9') {
+            dataLeft = dataLeft * 16 + (c - '0');
+          } else if (c >= 'a' && c <= 'f') {
+            dataLeft = dataLeft * 16 + (c - 'a' + 10);
+          } else if (c >= 'A' && c <= 'F') {
+            dataLeft = dataLeft * 16 + (c - 'A' + 10);
+          } else {
+            return false;
+          }
+          sizeDigits++;
+          return true;
+        case Extension:
+          return c != '\n' || endSizeLine();
+        case DataEnd:
+          if (c == '\n') {
+            reset();
+            return true;
+          }
+          return c == '\r';
+        case Trailer:
+          if (c == '\n') {
+            state = Done;
+          } else if (c != '\r') {
+            state = TrailerLine;
+          }
+          return true;
+        case TrailerLine:
+          if (c == '\n') {
+            state = Trailer;
+          }
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    // n bytes of chunk data have been read
+    void consumed(size_t n) {
+      dataLeft -= n;
+      if (dataLeft == 0) {
+        state = DataEnd;
+      }
+    }
+
+    bool endSizeLine() {
+      if (sizeDigits == 0) {
+        return false;
+      }
+      // the last chunk has size 0 and is followed by optional trailers and an empty line
+      state = dataLeft > 0 ? Data : Trailer;
+      return true;
+    }
+
+    State state = Size;
+    size_t dataLeft = 0;
+    size_t sizeDigits = 0;
+  };
+
+  /**
+    * Collects the request in a buffer and writes it to the client in chunks of the buffer size.
+    */
+  struct RequestWriter : public Print {
+    RequestWriter(Client& client, uint8_t* buffer, size_t size)
+      : client(client), buffer(buffer), size(size) {}
+
+    size_t write(uint8_t c) {
+      return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* data, size_t length) {
+      if (failed) {
+        return 0;
+      }
+      size_t accepted = length;
+      while (length > 0) {
+        if (used == size) {
+          sendBuffered();
+          if (failed) {
+            return accepted - length;
+          }
+        }
+        size_t n = length < size - used ? length : size - used;
+        memcpy(buffer + used, data, n);
+        used += n;
+        data += n;
+        length -= n;
+      }
+      return accepted;
+    }
+
+    // write the buffered bytes to the client
+    void sendBuffered() {
+      if (used > 0 && !failed) {
+        size_t n = client.write(buffer, used);
+        sent += n;
+        failed = n != used;
+      }
+      used = 0;
+    }
+
+    Client& client;
+    uint8_t* buffer;
+    size_t size;
+    size_t used = 0;
+    size_t sent = 0;
+    bool failed = false;
+  };
+
+  /**
+    * Buffers the bytes received from the client, so that they are read in chunks of up to the buffer
+    * size instead of one at a time. Bytes received beyond the current response stay in the buffer for
+    * the next response on the same connection, the buffer is cleared when the connection is closed.
+    */
+  struct ReadBuffer {
+    ReadBuffer(Client& client) : client(client) {}
+
+    void setBuffer(uint8_t* buffer, size_t size) {
+      if (buffer != nullptr && size > 0) {
+        this->buffer = buffer;
+        this->size = size;
+      } else {
+        this->buffer = defaultBuffer;
+        this->size = sizeof(defaultBuffer);
+      }
+      clear();
+    }
+
+    void clear() {
+      start = 0;
+      end = 0;
+    }
+
+    // number of bytes that can be read without waiting
+    int available() {
+      if (end > start) {
+        return end - start;
+      }
+      return client.available();
+    }
+
+    // next byte without waiting, -1 if none has been received
+    int read() {
+      if (end == start && !fill(false)) {
+        return -1;
+      }
+      return buffer[start++];
+    }
+
+    // like Stream::readBytes(), waits up to the timeout of the client for each chunk
+    size_t readBytes(char* data, size_t length) {
+      size_t bytesRead = 0;
+      while (bytesRead < length) {
+        if (end == start && !fill(true)) {
+          break;
+        }
+        bytesRead += take(data + bytesRead, length - bytesRead);
+      }
+      return bytesRead;
+    }
+
+    // read up to length bytes without waiting
+    size_t readAvailable(char* data, size_t length) {
+      size_t bytesRead = take(data, length);
+      if (bytesRead < length && client.available() > 0) {
+        // a large read goes straight into the caller's memory
+        int n = client.read(reinterpret_cast<uint8_t*>(data) + bytesRead, length - bytesRead);
+        if (n > 0) {
+          bytesRead += n;
+          received += n;
+        }
+      }
+      return bytesRead;
+    }
+
+  private:
+    size_t take(char* data, size_t length) {
+      size_t n = end - start < length ? end - start : length;
+      memcpy(data, buffer + start, n);
+      start += n;
+      return n;
+    }
+
+    // refill the empty buffer with what the client has received, never asks for more than is available
+    bool fill(bool wait) {
+      start = 0;
+      end = 0;
+      int n = client.available();
+      if (n > 0) {
+        n = client.read(buffer, static_cast<size_t>(n) < size ? n : size);
+      } else if (wait) {
+        n = client.readBytes(buffer, 1);
+      }
+      if (n <= 0) {
+        return false;
+      }
+      end = n;
+      received += n;
+      return true;
+    }
+
+    Client& client;
+    uint8_t defaultBuffer[Features::ReadBufferSize];
+    uint8_t* buffer = defaultBuffer;
+    size_t size = sizeof(defaultBuffer);
+    size_t start = 0;
+    size_t end = 0;
+
+  public:
+    // bytes received from the client since construction
+    size_t received = 0;
+  };
+
+  /**
+    * Reader for deserializeJson() that stops at the end of the response body,
+    * so a kept-alive connection is left at the start of the next response.
+    * Can push back the last character read, the cursor uses that to scan the result object.
+    */
+  struct BodyReader {
+    BodyReader(ReadBuffer& stream) : stream(stream) {}
+
+    void reset(size_t length) {
+      remaining = length;
+      memory = nullptr;
+      chunked = false;
+      last = -1;
+      pushedBack = false;
+    }
+
+    // read a body sent with Transfer-Encoding: chunked
+    void resetChunked() {
+      reset(SIZE_MAX);
+      chunked = true;
+      chunks.reset();
+    }
+
+    // read the body from a buffer that has already been received
+    void resetMemory(const char* data, size_t length) {
+      reset(length);
+      memory = data;
+    }
+
+    int read() {
+      if (pushedBack) {
+        pushedBack = false;
+        return last;
+      }
+      char c;
+      last = readBytes(&c, 1) == 1 ? static_cast<unsigned char>(c) : -1;
+      return last;
+    }
+
+    size_t readBytes(char* buffer, size_t length) {
+      size_t bytesRead = 0;
+      if (pushedBack && length > 0) {
+        pushedBack = false;
+        buffer[bytesRead++] = last;
+      }
+      size_t wanted = length - bytesRead;
+      if (wanted > remaining) {
+        wanted = remaining;
+      }
+      size_t n = 0;
+      if (wanted > 0 && memory != nullptr) {
+        memcpy(buffer + bytesRead, memory, wanted);
+        memory += wanted;
+        n = wanted;
+      } else if (wanted > 0 && chunked) {
+        n = readChunked(buffer + bytesRead, wanted);
+      } else if (wanted > 0) {
+        n = stream.readBytes(buffer + bytesRead, wanted);
+      }
+      if (remaining != SIZE_MAX) {
+        remaining -= n;
+      }
+      bytesRead += n;
+      if (bytesRead > 0) {
+        last = static_cast<unsigned char>(buffer[bytesRead - 1]);
+      }
+      return bytesRead;
+    }
+
+    // read chunk data, stops at the end of the body or when the framing is broken
+    size_t readChunked(char* buffer, size_t length) {
+      size_t n = 0;
+      while (n < length && chunks.state != ChunkDecoder::Done) {
+        if (chunks.state == ChunkDecoder::Data) {
+          size_t wanted = length - n < chunks.dataLeft ? length - n : chunks.dataLeft;
+          size_t got = stream.readBytes(buffer + n, wanted);
+          chunks.consumed(got);
+          n += got;
+          if (got < wanted) {
+            break;
+          }
+        } else {
+          char c;
+          if (stream.readBytes(&c, 1) != 1 || !chunks.frame(c)) {
+            break;
+          }
+        }
+      }
+      return n;
+    }
+
+    // make the last character read available again
+    void unread() {
+      pushedBack = last >= 0;
+    }
+
+    int readNonWhitespace() {
+      int c;
+      do {
+        c = read();
+      } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+      return c;
+    }
+
+    int peekNonWhitespace() {
+      readNonWhitespace();
+      unread();
+      return last;
+    }
+
+    // skip the rest of the body, returns false if its end is unknown or the connection ended early
+    bool drain() {
+      char scratch[16];
+      if (chunked) {
+        while (readBytes(scratch, sizeof(scratch)) > 0) {
+        }
+        return chunks.state == ChunkDecoder::Done;
+      }
+      if (remaining == SIZE_MAX) {
+        return false;
+      }
+      while (remaining > 0) {
+        if (readBytes(scratch, sizeof(scratch)) == 0) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    ReadBuffer& stream;
+    ChunkDecoder chunks;
+    bool chunked = false;
+    const char* memory = nullptr;
+    size_t remaining = 0;
+    int last = -1;
+    bool pushedBack = false;
+  };
+
+  NeonClientInstrumentation<Features::Instrumentation> instrumentation;
+  // counts and limits the memory of the result of execute(), declared before the document that uses it
+  NeonTrackingAllocator responseMemory;
+  JsonDocument request;
+  JsonDocument response;
+  NeonTransactionState<Features::Transactions, Features::MaxTransactionQueryFilters> txn;
+  Transport& client;
+  const char* connstr;
+  const char* proxy;
+  const int proxyPort;
+  // the tracking allocator of the result of the current or last request
+  NeonTrackingAllocator* resultMemory;
+  bool budgetExceeded = false;
+  NeonMemoryBudgetError budgetError = {};
+  NeonSqlErrorDetails sqlErrorDetails = {};
+  bool sqlErrorParsed = false;
+  NeonRetryPolicy retryPolicy = { 1, 500, 30000, 0, 60000 };
+  bool idempotent = false;
+  NeonErrorKind errorKind = NeonNoError;
+  uint8_t consecutiveFailures = 0;
+  bool breakerOpen = false;
+  unsigned long breakerOpenedAt = 0;
+  char status[Features::StatusSize];
+  bool keepAlive = false;
+  unsigned long idleTimeout = 30000;
+  bool connectionOpen = false;
+  unsigned long lastActivity = 0;
+  bool staleConnection = false;
+  bool responseKeepAlive = false;
+  // set while a request of executePipeline() is sent that is followed by another one
+  bool pipelineKeepOpen = false;
+  ReadBuffer input{client};
+  BodyReader body{input};
+  bool cursorOpen = false;
+  bool cursorInRows = false;
+  const char* cursorError = nullptr;
+  const JsonDocument* cursorFilter = nullptr;
+  int statusCode = 0;
+  bool headDone = false;
+  bool headStatusLine = true;
+  char headLine[Features::ResponseLineSize];
+  size_t headLineLength = 0;
+  size_t contentLength = SIZE_MAX;
+  bool chunked = false;
+  struct CapturedHeader {
+    const char* name;
+    char value[Features::ResponseLineSize];
+    bool received;
+  };
+  CapturedHeader capturedHeaders[Features::MaxResponseHeaders];
+  size_t capturedHeaderCount = 0;
+  const JsonDocument* responseFilter = nullptr;
+  bool arrayMode = false;
+  uint8_t* writeBuffer = nullptr;
+  size_t writeBufferSize = 0;
+  Resolver resolver = nullptr;
+  IpConnector ipConnector = nullptr;
+  unsigned long resolveTtl = 300000;
+  bool resolved = false;
+  unsigned long resolvedAt = 0;
+  IPAddress resolvedIp;
+  NeonTlsSessionCache* tlsSessionCache = nullptr;
+  enum AsyncState {
+    AsyncIdle,
+    AsyncConnecting,
+    AsyncSending,
+    AsyncHead,
+    AsyncBody,
+    AsyncDone
+  };
+  AsyncState asyncState = AsyncIdle;
+  RequestPayload asyncSrc;
+  JsonDocument* asyncDst = nullptr;
+  const JsonDocument* asyncFilter = nullptr;
+  bool asyncPerQuery = false;
+  unsigned long asyncStart = 0;
+  unsigned long asyncTimeout = 0;
+  bool asyncReused = false;
+  bool asyncReceived = false;
+  const char* asyncError = nullptr;
+  ChunkDecoder asyncChunks;
+  char* asyncBody = nullptr;
+  size_t asyncBodyLength = 0;
+  size_t asyncBodyCapacity = 0;
+};
+
+// the client with a Wifi client as transport and all features, configured by the NEON_ macros above
+typedef BasicNeonClient<WiFiClient, NeonDefaultFeatures> NeonPostgresOverHTTPProxyClient;
 
-#endif /* NeonPostgresOverHTTPProxyClient_H */
\ No newline at end of file
+#endif /* NEONPOSTGRESOVERHTTPPROXYCLIENT_H */
@@ -0,0 +1,504 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESPOOL_H
+#define NEONPOSTGRESPOOL_H
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+#include "NeonPostgresOverHTTP.h"
+#include "NeonPostgresValue.h"
+
+// maximum length of an error message returned in a NeonPoolCompletion, longer messages are truncated
+#ifndef NEON_POOL_MAX_ERROR_LENGTH
+#define NEON_POOL_MAX_ERROR_LENGTH 64
+#endif
+
+// endpoint of statements that may run on any client of a NeonPostgresPool
+#define NEON_POOL_ANY_ENDPOINT 0xff
+
+/**
+ * @brief Outcome of a statement executed by NeonPostgresPool
+ */
+struct NeonPoolCompletion {
+  // id returned by NeonPostgresPool::enqueue()
+  uint32_t id;
+  // index of the client that executed the statement, in the order of addClient()
+  uint8_t client;
+  // true if errorMessage is set
+  bool failed;
+  // number of rows returned or affected
+  int rowCount;
+  // copy of the error message, empty on success
+  char errorMessage[NEON_POOL_MAX_ERROR_LENGTH];
+};
+
+/**
+ * @brief Executes queued statements on several clients at the same time, each with its own connection,
+ *        for example to keep up with a high insert rate or to write to more than one project.
+ *        Every client is bound to an endpoint number, statements queued with enqueueTo() only run on
+ *        clients of that endpoint, statements queued with enqueue() on any client.
+ *        The next statement goes to the first idle client, so a slow request does not hold up the others.
+ *        The clients keep their connections open, and with setWarmInterval() an idle client sends
+ *        SELECT 1 now and then so that its connection and the compute endpoint do not go cold.
+ *
+ *        Without tasks poll() drives all clients with executeAsync() from loop().
+ *        On ESP32 beginTasks() instead runs every client in its own FreeRTOS task, pinned alternately to
+ *        both cores on dual-core chips, and poll() must not be called.
+ *        The pool owns its clients and their WiFiClients, do not use them elsewhere.
+ * @example
+ * ```cpp
+ * WiFiClient wifiClients[3];
+ * NeonPostgresOverHTTPProxyClient sqlClients[3] = { { wifiClients[0], DATABASE_URL, PROXY_HOST },
+ *                                                   { wifiClients[1], DATABASE_URL, PROXY_HOST },
+ *                                                   { wifiClients[2], OTHER_DATABASE_URL, PROXY_HOST } };
+ * NeonPostgresPool<3> pool;
+ *
+ * void setup() {
+ *   ...
+ *   pool.addClient(sqlClients[0]);
+ *   pool.addClient(sqlClients[1]);
+ *   pool.addClient(sqlClients[2], 1);
+ *   pool.setWarmInterval(60000);
+ * }
+ *
+ * void loop() {
+ *   pool.enqueue(insertSensorValue, "temperature", temperature);
+ *   pool.enqueueTo(1, insertEvent, "restart");
+ *   pool.poll();
+ *   NeonPoolCompletion completion;
+ *   while (pool.getCompletion(completion)) {
+ *     if (completion.failed) {
+ *       Serial.println(completion.errorMessage);
+ *     }
+ *   }
+ * }
+ * ```
+ *
+ * @tparam Clients maximum number of clients
+ * @tparam QueueLength number of statements that can be waiting, also the number of completions kept
+ * @tparam MaxParams maximum number of parameters of a statement
+ * @tparam TextBytes buffer size per statement for the text parameters including their terminating 0
+ * @tparam Client the database client type, a BasicNeonClient. Without Features::KeepAlive every statement
+ *                opens its own connection
+ */
+template <size_t Clients, size_t QueueLength = 16, size_t MaxParams = 4, size_t TextBytes = 48,
+          typename Client = NeonPostgresOverHTTPProxyClient>
+class NeonPostgresPool {
+  static_assert(Clients > 0 && Clients < NEON_POOL_ANY_ENDPOINT, "Clients must be between 1 and 254");
+
+public:
+  /**
+     * @brief Called after each statement, by poll() or in the task of the client. The client still
+     *        holds the result, so rows can be read here.
+     */
+  typedef void (*ResultCallback)(const NeonPoolCompletion& completion, Client& client, void* context);
+
+  /**
+     * @brief Add a client to the pool and enable keep-alive on it if its Features have KeepAlive.
+     *        Add all clients before the first statement is executed.
+     *
+     * @param client client with its own transport, connected to endpoint. This reference must be valid for
+     *               the complete lifetime of the pool
+     * @param endpoint number of the endpoint (database URL) of the client, see enqueueTo()
+     * @param idleTimeout close the connection after this many milliseconds without a request
+     *
+     * @return false if Clients clients have been added already
+     */
+  bool addClient(Client& client, uint8_t endpoint = 0, unsigned long idleTimeout = 30000) {
+    if (clientCount == Clients || endpoint == NEON_POOL_ANY_ENDPOINT) {
+      return false;
+    }
+    Connection& connection = connections[clientCount++];
+    connection.client = &client;
+    connection.endpoint = endpoint;
+    // the first SELECT 1 is due warmInterval after the client was added, not at the first poll()
+    connection.lastUsed = millis();
+    enableKeepAlive(client, idleTimeout, WithKeepAlive<Client::FeatureSet::KeepAlive>());
+    return true;
+  }
+
+  // maximum time in milliseconds to wait for the response to a statement
+  void setTimeout(unsigned long timeout) {
+    this->timeout = timeout;
+  }
+
+  /**
+     * @brief Let idle clients send SELECT 1 after interval milliseconds without a statement, to keep their
+     *        connection open and the compute endpoint awake. Use an interval below the idleTimeout of
+     *        addClient() and the suspend timeout of the endpoint. 0 (the default) disables it.
+     */
+  void setWarmInterval(unsigned long interval) {
+    warmInterval = interval;
+  }
+
+  /**
+     * @brief Set a function that is called after each statement.
+     */
+  void setResultCallback(ResultCallback callback, void* context = nullptr) {
+    resultCallback = callback;
+    resultContext = context;
+  }
+
+  /**
+     * @brief Queue a statement for the next idle client. Never blocks and never allocates memory.
+     *        Supported parameter types are bool, integers, float, double, const char* and nullptr for NULL.
+     *        Text parameters are copied.
+     *
+     * @param query SQL statement text. This pointer must be valid until the statement has been executed,
+     *              it is NOT copied, usually it is a constant.
+     *
+     * @return id of the statement used in its NeonPoolCompletion, 0 if the queue is full or the text
+     *         parameters do not fit into TextBytes
+     */
+  template <typename... Values>
+  uint32_t enqueue(const char* query, Values... values) {
+    return enqueueTo(NEON_POOL_ANY_ENDPOINT, query, values...);
+  }
+
+  /**
+     * @brief Like enqueue(), for the next idle client of one endpoint.
+     *
+     * @param endpoint endpoint number given to addClient()
+     */
+  template <typename... Values>
+  uint32_t enqueueTo(uint8_t endpoint, const char* query, Values... values) {
+    static_assert(sizeof...(Values) <= MaxParams, "too many parameters for MaxParams");
+    Statement* statement = reserve();
+    if (statement == nullptr) {
+      return 0;
+    }
+    statement->endpoint = endpoint;
+    statement->query = query;
+    statement->paramCount = 0;
+    statement->textUsed = 0;
+    bool stored = storeParams(*statement, values...);
+    uint32_t id = 0;
+    lock();
+    if (stored) {
+      nextId = nextId == UINT32_MAX ? 1 : nextId + 1;
+      id = nextId;
+      statement->id = id;
+      statement->sequence = nextSequence++;
+    }
+    statement->state = stored ? Queued : Free;
+    unlock();
+    // once unlocked a client may already have taken the statement and freed its slot
+    if (id == 0) {
+      return 0;
+    }
+    wake(endpoint);
+    return id;
+  }
+
+  /**
+     * @brief Start queued statements on idle clients and advance the running ones, call it from loop().
+     *        Does nothing after beginTasks().
+     *
+     * @return number of clients with a statement in progress
+     */
+  size_t poll() {
+    if (tasksStarted) {
+      return 0;
+    }
+    size_t busy = 0;
+    for (size_t i = 0; i < clientCount; i++) {
+      Connection& connection = connections[i];
+      if (connection.state != Idle && connection.client->poll()) {
+        finish(i, connection.client->getAsyncError());
+      }
+      if (connection.state == Idle && load(i)) {
+        connection.client->executeAsync(timeout);
+      }
+      if (connection.state != Idle) {
+        busy++;
+      }
+    }
+    return busy;
+  }
+
+#if defined(ARDUINO_ARCH_ESP32)
+  /**
+     * @brief Run every client in its own FreeRTOS task (ESP32 only), client i on core i % portNUM_PROCESSORS.
+     *        After this call poll() does nothing. Call it after addClient().
+     *
+     * @param priority FreeRTOS priority of the tasks
+     * @param stackSize stack size of each task in bytes
+     *
+     * @return false if a task could not be created
+     */
+  bool beginTasks(UBaseType_t priority = 1, uint32_t stackSize = 8192) {
+    if (tasksStarted) {
+      return true;
+    }
+    tasksStarted = true;
+    for (size_t i = 0; i < clientCount; i++) {
+      connections[i].pool = this;
+      BaseType_t core = static_cast<BaseType_t>(i % portNUM_PROCESSORS);
+      if (xTaskCreatePinnedToCore(run, "NeonPostgresPool", stackSize, &connections[i], priority, &connections[i].task, core) != pdPASS) {
+        return false;
+      }
+    }
+    return true;
+  }
+#endif
+
+  /**
+     * @brief Get the outcome of the next executed statement without waiting.
+     *
+     * @return false if no statement has completed since the last call
+     */
+  bool getCompletion(NeonPoolCompletion& completion) {
+    lock();
+    bool available = completionCount > 0;
+    if (available) {
+      completion = completions[completionHead];
+      completionHead = (completionHead + 1) % QueueLength;
+      completionCount--;
+    }
+    unlock();
+    return available;
+  }
+
+  // number of completions dropped because nobody called getCompletion()
+  uint32_t getDroppedCompletions() const {
+    return droppedCompletions;
+  }
+
+  // number of statements waiting for a client
+  size_t getQueuedCount() {
+    lock();
+    size_t queued = 0;
+    for (size_t i = 0; i < QueueLength; i++) {
+      queued += statements[i].state == Queued ? 1 : 0;
+    }
+    unlock();
+    return queued;
+  }
+
+private:
+  enum StatementState : uint8_t {
+    Free,
+    // being filled by enqueueTo()
+    Filling,
+    Queued,
+  };
+
+  enum ConnectionState : uint8_t {
+    Idle,
+    Running,
+    // executing the SELECT 1 of setWarmInterval(), which has no completion
+    Warming,
+  };
+
+  struct Statement {
+    StatementState state = Free;
+    uint8_t endpoint;
+    uint32_t id;
+    // order of the statements, the oldest statement for a client runs first
+    uint32_t sequence;
+    const char* query;
+    size_t paramCount;
+    NeonPostgresValue params[MaxParams];
+    char text[TextBytes];
+    size_t textUsed;
+  };
+
+  struct Connection {
+    Client* client = nullptr;
+    uint8_t endpoint = 0;
+    ConnectionState state = Idle;
+    uint32_t id = 0;
+    unsigned long lastUsed = 0;
+#if defined(ARDUINO_ARCH_ESP32)
+    NeonPostgresPool* pool = nullptr;
+    TaskHandle_t task = nullptr;
+#endif
+  };
+
+  template <bool>
+  struct WithKeepAlive {};
+
+  static void enableKeepAlive(Client& client, unsigned long idleTimeout, WithKeepAlive<true>) {
+    client.setKeepAlive(true, idleTimeout);
+  }
+
+  static void enableKeepAlive(Client&, unsigned long, WithKeepAlive<false>) {}
+
+  Statement* reserve() {
+    lock();
+    Statement* statement = nullptr;
+    for (size_t i = 0; i < QueueLength && statement == nullptr; i++) {
+      if (statements[i].state == Free) {
+        statement = &statements[i];
+        statement->state = Filling;
+      }
+    }
+    unlock();
+    return statement;
+  }
+
+  bool storeParams(Statement&) {
+    return true;
+  }
+
+  template <typename Value, typename... Rest>
+  bool storeParams(Statement& statement, Value value, Rest... rest) {
+    NeonPostgresValue v(value);
+    if (v.type == NeonPostgresValue::Text) {
+      size_t len = strlen(v.textValue) + 1;
+      if (statement.textUsed + len > TextBytes) {
+        return false;
+      }
+      memcpy(statement.text + statement.textUsed, v.textValue, len);
+      v.textValue = statement.text + statement.textUsed;
+      statement.textUsed += len;
+    }
+    statement.params[statement.paramCount++] = v;
+    return storeParams(statement, rest...);
+  }
+
+  /**
+     * Take the oldest queued statement for a client and set it as the statement of the client, or the
+     * SELECT 1 of setWarmInterval() if there is none and the client has been idle long enough.
+     *
+     * @return false if the client has nothing to do
+     */
+  bool load(size_t index) {
+    Connection& connection = connections[index];
+    lock();
+    Statement* statement = nullptr;
+    for (size_t i = 0; i < QueueLength; i++) {
+      Statement& candidate = statements[i];
+      if (candidate.state == Queued && (candidate.endpoint == NEON_POOL_ANY_ENDPOINT || candidate.endpoint == connection.endpoint)
+          && (statement == nullptr || static_cast<int32_t>(candidate.sequence - statement->sequence) < 0)) {
+        statement = &candidate;
+      }
+    }
+    if (statement != nullptr) {
+      // no other client takes it now, the slot is freed after its parameters have been copied
+      statement->state = Filling;
+    }
+    unlock();
+    Client& client = *connection.client;
+    JsonArray params = client.getParams();
+    if (statement == nullptr) {
+      if (warmInterval == 0 || millis() - connection.lastUsed < warmInterval) {
+        return false;
+      }
+      client.setStaticQuery("SELECT 1");
+      params.clear();
+      connection.state = Warming;
+      return true;
+    }
+    client.setStaticQuery(statement->query);
+    params.clear();
+    for (size_t i = 0; i < statement->paramCount; i++) {
+      statement->params[i].addTo(params);
+    }
+    connection.id = statement->id;
+    connection.state = Running;
+    // the query text is only referenced and used until the statement has been executed, which the caller
+    // guarantees. Free the slot for the producer
+    lock();
+    statement->state = Free;
+    unlock();
+    return true;
+  }
+
+  void finish(size_t index, const char* errorMessage) {
+    Connection& connection = connections[index];
+    ConnectionState state = connection.state;
+    connection.state = Idle;
+    connection.lastUsed = millis();
+    if (state == Warming) {
+      return;
+    }
+    NeonPoolCompletion completion;
+    completion.id = connection.id;
+    completion.client = static_cast<uint8_t>(index);
+    completion.failed = errorMessage != nullptr;
+    completion.rowCount = completion.failed ? 0 : connection.client->getRowCount();
+    strncpy(completion.errorMessage, completion.failed ? errorMessage : "", sizeof(completion.errorMessage) - 1);
+    completion.errorMessage[sizeof(completion.errorMessage) - 1] = 0;
+    if (resultCallback != nullptr) {
+      resultCallback(completion, *connection.client, resultContext);
+    }
+    lock();
+    if (completionCount == QueueLength) {
+      droppedCompletions++;
+    } else {
+      completions[(completionHead + completionCount) % QueueLength] = completion;
+      completionCount++;
+    }
+    unlock();
+  }
+
+#if defined(ARDUINO_ARCH_ESP32)
+  static void run(void* connection) {
+    Connection* self = static_cast<Connection*>(connection);
+    self->pool->work(self - self->pool->connections);
+  }
+
+  void work(size_t index) {
+    Connection& connection = connections[index];
+    while (true) {
+      if (!load(index)) {
+        // woken by enqueueTo(), or in time for the next SELECT 1
+        ulTaskNotifyTake(pdTRUE, warmInterval == 0 ? portMAX_DELAY : pdMS_TO_TICKS(warmInterval));
+        continue;
+      }
+      finish(index, connection.client->execute(timeout));
+    }
+  }
+
+  void wake(uint8_t endpoint) {
+    if (!tasksStarted) {
+      return;
+    }
+    // every idle task of the endpoint competes for the statement, the others go back to sleep
+    for (size_t i = 0; i < clientCount; i++) {
+      if (connections[i].task != nullptr && (endpoint == NEON_POOL_ANY_ENDPOINT || connections[i].endpoint == endpoint)) {
+        xTaskNotifyGive(connections[i].task);
+      }
+    }
+  }
+
+  // the statements and completions are shared by the tasks on both cores, hold the lock only for a few instructions
+  void lock() {
+    portENTER_CRITICAL(&mux);
+  }
+
+  void unlock() {
+    portEXIT_CRITICAL(&mux);
+  }
+
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#else
+  void wake(uint8_t) {}
+
+  // poll() runs in the same task as enqueueTo() and getCompletion()
+  void lock() {}
+  void unlock() {}
+#endif
+
+  Connection connections[Clients];
+  size_t clientCount = 0;
+  Statement statements[QueueLength];
+  uint32_t nextId = 0;
+  uint32_t nextSequence = 0;
+  NeonPoolCompletion completions[QueueLength];
+  size_t completionHead = 0;
+  size_t completionCount = 0;
+  volatile uint32_t droppedCompletions = 0;
+  unsigned long timeout = 20000;
+  unsigned long warmInterval = 0;
+  ResultCallback resultCallback = nullptr;
+  void* resultContext = nullptr;
+  bool tasksStarted = false;
+};
+
+#endif /* NEONPOSTGRESPOOL_H */
@@ -0,0 +1,122 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESPREPAREDSTATEMENT_H
+#define NEONPOSTGRESPREPAREDSTATEMENT_H
+#include <ArduinoJson.h>
+#include <cstring>
+#include "NeonPostgresAllocator.h"
+
+/**
+ * @brief A statement that is executed many times with different parameters.
+ *        prepare() escapes the SQL text once and keeps the beginning of the request payload
+ *        {"query":"...","params": ready to send. Executing the statement only serializes and measures
+ *        the parameters, not the SQL text again, which saves CPU time for long statements.
+ *        Execute it with NeonPostgresOverHTTPProxyClient::execute(NeonPreparedStatement&).
+ * @example
+ * ```cpp
+ * NeonPreparedStatement insertStatement;
+ *
+ * void setup() {
+ *   ...
+ *   insertStatement.prepare(insertSensorValue);
+ * }
+ *
+ * void loop() {
+ *   JsonArray params = insertStatement.getParams();
+ *   params.add("temperature");
+ *   params.add(temperature);
+ *   const char* errorMessage = sqlClient.execute(insertStatement);
+ *   ...
+ * }
+ * ```
+ */
+class NeonPreparedStatement {
+public:
+  /**
+     * @param allocator ArduinoJson allocator for the payload prefix and the parameters
+     */
+  NeonPreparedStatement(ArduinoJson::Allocator* allocator = NeonHeapAllocator::instance())
+    : params(allocator), allocator(allocator) {}
+
+  NeonPreparedStatement(const NeonPreparedStatement&) = delete;
+  NeonPreparedStatement& operator=(const NeonPreparedStatement&) = delete;
+
+  ~NeonPreparedStatement() {
+    release();
+  }
+
+  /**
+     * @brief Render and keep the beginning of the request payload for a SQL statement.
+     *        Can be called again to prepare another statement.
+     *
+     * @param query SQL statement text, optionally with parameter markers. It is copied in escaped form.
+     *
+     * @return false if the statement does not fit into memory
+     */
+  bool prepare(const char* query) {
+    release();
+    JsonDocument doc(allocator);
+    if (!doc["query"].set(query)) {
+      return false;
+    }
+    // {"query":"..."} without the closing brace, followed by ,"params":
+    static const char paramsKey[] = ",\"params\":";
+    size_t length = measureJson(doc);
+    size_t size = length - 1 + sizeof(paramsKey);
+    prefix = static_cast<char*>(allocator->allocate(size));
+    if (prefix == nullptr) {
+      return false;
+    }
+    serializeJson(doc, prefix, size);
+    memcpy(prefix + length - 1, paramsKey, sizeof(paramsKey));
+    prefixLength = size - 1;
+    params.to<JsonArray>();
+    return true;
+  }
+
+  /**
+     * @brief Get an empty parameter array for the next execution, see
+     *        NeonPostgresOverHTTPProxyClient::getParams()
+     */
+  JsonArray getParams() {
+    return params.to<JsonArray>();
+  }
+
+  // true if prepare() succeeded
+  bool isPrepared() const {
+    return prefix != nullptr;
+  }
+
+  // free the memory of the statement, it must be prepared again before it is executed
+  void release() {
+    if (prefix != nullptr) {
+      allocator->deallocate(prefix);
+    }
+    prefix = nullptr;
+    prefixLength = 0;
+    params.clear();
+  }
+
+  // length of the Json request payload with the current parameters
+  size_t measure() const {
+    return prefixLength + measureJson(params) + 1;
+  }
+
+  // write the Json request payload with the current parameters, returns the number of bytes written
+  size_t writeTo(Print& out) const {
+    size_t written = out.write(reinterpret_cast<const uint8_t*>(prefix), prefixLength);
+    written += serializeJson(params, out);
+    written += out.write('}');
+    return written;
+  }
+
+private:
+  JsonDocument params;
+  ArduinoJson::Allocator* allocator;
+  char* prefix = nullptr;
+  size_t prefixLength = 0;
+};
+
+#endif /* NEONPOSTGRESPREPAREDSTATEMENT_H */
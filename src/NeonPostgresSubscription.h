@@ -0,0 +1,212 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESSUBSCRIPTION_H
+#define NEONPOSTGRESSUBSCRIPTION_H
+#include "NeonPostgresOverHTTP.h"
+#include "NeonPostgresValue.h"
+
+// maximum length of the high-water mark as text, enough for a timestamp with microseconds and time zone
+#ifndef NEON_SUBSCRIPTION_MARK_SIZE
+#define NEON_SUBSCRIPTION_MARK_SIZE 40
+#endif
+
+/**
+ * @brief Polls a query for rows that are newer than the newest row seen so far, for example commands
+ *        for an actuator. The query gets the high-water mark - the value of a monotonic column like a
+ *        timestamp or a serial of the last row received - as its last parameter and must return only
+ *        newer rows, in ascending order of that column.
+ *        The poll interval adapts: right after new rows the query is repeated after minInterval, then the
+ *        interval doubles with every poll without new rows up to maxInterval.
+ *
+ *        The subscription uses the statement of the client (setQuery()/getParams()),
+ *        set them again after a poll if you also use them directly.
+ * @example
+ * ```cpp
+ * const char* newActorValues = R"SQL(
+ * SELECT actor_value, sent_time FROM actorvalues
+ * WHERE actor_name = $1::text AND sent_time > $2::timestamp
+ * ORDER BY sent_time LIMIT 10
+ * )SQL";
+ * NeonPostgresSubscription<1> ledCommands(sqlClient, newActorValues, "sent_time");
+ *
+ * void setup() {
+ *   ...
+ *   ledCommands.setParams("led");
+ *   ledCommands.setPollInterval(1000, 60000);
+ * }
+ *
+ * void loop() {
+ *   int rows = ledCommands.poll();
+ *   if (rows > 0) {
+ *     for (JsonObject row : sqlClient.getRows()) {
+ *       digitalWrite(ledPin, strcmp(row["actor_value"], "on") == 0 ? HIGH : LOW);
+ *     }
+ *   }
+ * }
+ * ```
+ *
+ * @tparam Params number of parameters of the query before the high-water mark
+ * @tparam Client the database client type, a BasicNeonClient
+ */
+template <size_t Params = 0, typename Client = NeonPostgresOverHTTPProxyClient>
+class NeonPostgresSubscription {
+public:
+  /**
+     * @brief Constructs a subscription.
+     *
+     * @param client the database client used to run the query
+     * @param query SQL text, the high-water mark is parameter $Params+1
+     * @param markColumn the monotonic column in the result whose last value becomes the new high-water mark,
+     *                   it is found by name also when the client returns rows as arrays
+     * @param initialMark high-water mark of the first query, for example "-infinity" for timestamps or "0" for serials
+     *
+     * All pointers must be valid for the complete lifetime of the subscription, they are NOT copied
+     */
+  NeonPostgresSubscription(Client& client, const char* query, const char* markColumn,
+                           const char* initialMark = "-infinity")
+    : client(client), query(query), markColumn(markColumn) {
+    setMark(initialMark);
+    filter["rows"] = true;
+    filter["rowCount"] = true;
+    // the names of the columns locate markColumn in rows returned as arrays, see setArrayMode()
+    filter["fields"][0]["name"] = true;
+  }
+
+  /**
+     * @brief Set the parameters of the query that precede the high-water mark, one value per parameter.
+     *        Supported types are bool, integers, float, double, const char* and nullptr for NULL.
+     *        Text values are NOT copied, they must be valid while they are set.
+     */
+  template <typename... Values>
+  void setParams(Values... values) {
+    static_assert(sizeof...(Values) == Params, "setParams() needs one value per parameter");
+    NeonPostgresValue list[Params + 1] = { NeonPostgresValue(values)... };
+    for (size_t i = 0; i < Params; i++) {
+      params[i] = list[i];
+    }
+  }
+
+  /**
+     * @brief Set how often poll() runs the query.
+     *
+     * @param minInterval milliseconds between polls right after new rows arrived
+     * @param maxInterval maximum milliseconds between polls while there are no new rows or the query fails
+     */
+  void setPollInterval(unsigned long minInterval, unsigned long maxInterval) {
+    this->minInterval = minInterval;
+    this->maxInterval = maxInterval < minInterval ? minInterval : maxInterval;
+    interval = minInterval;
+  }
+
+  /**
+     * @brief Run the query if the poll interval has elapsed. The new rows are available with
+     *        client.getRows() until the next request of the client.
+     *
+     * @param timeout maximum time in milliseconds to wait for response
+     *
+     * @return number of new rows, 0 if there are none or the interval has not elapsed yet,
+     *         -1 if the query failed or its last row has no value in markColumn, see getError().
+     *         The high-water mark is then unchanged, the rows are received again with the next poll
+     */
+  int poll(unsigned long timeout = 20000) {
+    if (polled && millis() - lastPoll < interval) {
+      return 0;
+    }
+    polled = true;
+    lastPoll = millis();
+    client.setStaticQuery(query);
+    JsonArray queryParams = client.getParams();
+    queryParams.clear();
+    for (size_t i = 0; i < Params; i++) {
+      params[i].addTo(queryParams);
+    }
+    queryParams.add(static_cast<const char*>(mark));
+    errorMessage = client.execute(filter, timeout);
+    if (errorMessage != nullptr) {
+      backOff();
+      return -1;
+    }
+    int rows = client.getRowCount();
+    if (rows <= 0) {
+      // nothing new, the rows are not looked at
+      backOff();
+      return 0;
+    }
+    JsonArray result = client.getRows();
+    JsonVariant lastRow = result[result.size() - 1];
+    JsonVariant last;
+    if (lastRow.is<JsonArray>()) {
+      int column = client.getColumnIndex(markColumn);
+      if (column >= 0) {
+        last = lastRow[static_cast<size_t>(column)];
+      }
+    } else {
+      last = lastRow[markColumn];
+    }
+    if (last.isNull()) {
+      // without a mark the subscription would either stop or receive the same rows forever
+      errorMessage = "high-water mark column is missing or NULL in the result";
+      backOff();
+      return -1;
+    }
+    if (last.is<const char*>()) {
+      setMark(last.as<const char*>());
+    } else {
+      // a numeric column, ArduinoJson prints it without losing precision
+      serializeJson(last, mark, sizeof(mark));
+    }
+    interval = minInterval;
+    return rows;
+  }
+
+  /**
+     * @brief Run the query with the next poll() regardless of the interval and start again at the
+     *        minimum interval, for example after the device has sent a command that expects an answer.
+     */
+  void wake() {
+    polled = false;
+    interval = minInterval;
+  }
+
+  // the high-water mark as text, save it to continue after a restart without receiving old rows again
+  const char* getMark() const {
+    return mark;
+  }
+
+  void setMark(const char* value) {
+    strncpy(mark, value, sizeof(mark) - 1);
+    mark[sizeof(mark) - 1] = 0;
+  }
+
+  // milliseconds until the next poll() runs the query
+  unsigned long getInterval() const {
+    return interval;
+  }
+
+  // error of the last query, nullptr if it succeeded
+  const char* getError() const {
+    return errorMessage;
+  }
+
+private:
+  void backOff() {
+    interval = interval < maxInterval / 2 ? interval * 2 : maxInterval;
+  }
+
+  Client& client;
+  const char* query;
+  const char* markColumn;
+  NeonPostgresValue params[Params + 1];
+  char mark[NEON_SUBSCRIPTION_MARK_SIZE];
+  JsonDocument filter;
+  unsigned long minInterval = 1000;
+  unsigned long maxInterval = 60000;
+  unsigned long interval = 1000;
+  unsigned long lastPoll = 0;
+  bool polled = false;
+  const char* errorMessage = nullptr;
+};
+
+#endif /* NEONPOSTGRESSUBSCRIPTION_H */
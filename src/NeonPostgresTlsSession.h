@@ -0,0 +1,115 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESTLSSESSION_H
+#define NEONPOSTGRESTLSSESSION_H
+
+// TLS session caches for NeonPostgresOverHTTPProxyClient::setTlsSessionCache().
+//
+// Support depends on the TLS client:
+// - ESP8266 BearSSL::WiFiClientSecure: NeonBearSSLSessionCache below, the session can be kept in RTC memory
+//   across deep sleep. It is the only cache in this file.
+// - SSLClient (BearSSL for any Client): caches sessions internally, no session cache is needed while the
+//   board is running.
+// - ESP32 WiFiClientSecure (mbedTLS) and WiFiNINA WiFiSSLClient: the TLS session is not accessible, the handshake
+//   cannot be resumed. Use setKeepAlive() to avoid reconnects instead.
+
+#if defined(ARDUINO_ARCH_ESP8266)
+
+#include <WiFiClientSecureBearSSL.h>
+#include "NeonPostgresOverHTTP.h"
+
+/**
+ * @brief Session cache for BearSSL::WiFiClientSecure on ESP8266. BearSSL stores the session
+ *        parameters after each handshake and offers them to the proxy on the next connect.
+ *        Optionally the session is saved to RTC user memory, which survives deep sleep.
+ *        The cache is bound to the BearSSL client the database client connects with.
+ * @example
+ * ```cpp
+ * BearSSL::WiFiClientSecure client;
+ * NeonPostgresOverHTTPProxyClient sqlClient(client, DATABASE_URL, NEON_PROXY);
+ * NeonBearSSLSessionCache sessionCache(client);
+ *
+ * void setup() {
+ *   ...
+ *   sessionCache.loadFromRtc();
+ *   sqlClient.setTlsSessionCache(&sessionCache);
+ * }
+ *
+ * void loop() {
+ *   ...
+ *   sessionCache.saveToRtc();
+ *   ESP.deepSleep(60e6);
+ * }
+ * ```
+ */
+class NeonBearSSLSessionCache : public NeonTlsSessionCache {
+public:
+  /**
+     * @param client the TLS client of the database client. This reference must be valid for the
+     *               complete lifetime of the cache, it is NOT copied
+     */
+  explicit NeonBearSSLSessionCache(BearSSL::WiFiClientSecure& client)
+    : client(client) {}
+
+  NeonBearSSLSessionCache(const NeonBearSSLSessionCache&) = delete;
+  NeonBearSSLSessionCache& operator=(const NeonBearSSLSessionCache&) = delete;
+
+  void beforeConnect(Client&) override {
+    client.setSession(&session);
+  }
+
+  void afterConnect(Client&, bool connected) override {
+    if (!connected) {
+      // do not offer a session the proxy might have rejected again
+      session = BearSSL::Session();
+    }
+  }
+
+  /**
+     * @brief Save the session to RTC user memory, for example before deep sleep.
+     *
+     * @param offset offset in RTC user memory in 4-byte blocks
+     *
+     * @return false if the session does not fit into RTC user memory at offset
+     */
+  bool saveToRtc(uint32_t offset = 0) {
+    RtcRecord record;
+    record.magic = Magic;
+    memcpy(record.session, &session, sizeof(session));
+    return ESP.rtcUserMemoryWrite(offset, reinterpret_cast<uint32_t*>(&record), sizeof(record));
+  }
+
+  /**
+     * @brief Restore the session saved with saveToRtc(), for example after waking from deep sleep.
+     *
+     * @param offset offset in RTC user memory in 4-byte blocks
+     *
+     * @return false if no session was saved at offset
+     */
+  bool loadFromRtc(uint32_t offset = 0) {
+    RtcRecord record;
+    if (!ESP.rtcUserMemoryRead(offset, reinterpret_cast<uint32_t*>(&record), sizeof(record)) || record.magic != Magic) {
+      return false;
+    }
+    // BearSSL::Session only holds the plain br_ssl_session_parameters, it can be copied byte by byte
+    memcpy(&session, record.session, sizeof(session));
+    return true;
+  }
+
+private:
+  static const uint32_t Magic = 0x4e545331;  // "NTS1"
+
+  struct RtcRecord {
+    uint32_t magic;
+    alignas(4) uint8_t session[(sizeof(BearSSL::Session) + 3) & ~3];
+  };
+
+  BearSSL::WiFiClientSecure& client;
+  BearSSL::Session session;
+};
+
+#endif /* ARDUINO_ARCH_ESP8266 */
+
+#endif /* NEONPOSTGRESTLSSESSION_H */
@@ -0,0 +1,134 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESVALUE_H
+#define NEONPOSTGRESVALUE_H
+#include <ArduinoJson.h>
+#include <climits>
+#include <cstring>
+
+/**
+ * @brief A single typed SQL parameter value that is stored without heap allocation.
+ *        Used by the helpers that buffer statements before they are sent, for example
+ *        NeonPostgresBatchInsert.
+ *        Text values are stored by pointer, the helpers that keep values copy the text
+ *        into their own buffers.
+ */
+struct NeonPostgresValue {
+  enum Type : uint8_t {
+    Null,
+    Bool,
+    Int,
+    Float,
+    Text,
+    // an unsigned integer above LLONG_MAX, smaller ones are stored as Int
+    Unsigned
+  };
+
+  NeonPostgresValue()
+    : type(Null), intValue(0) {}
+  NeonPostgresValue(std::nullptr_t)
+    : type(Null), intValue(0) {}
+  NeonPostgresValue(bool value)
+    : type(Bool), boolValue(value) {}
+  NeonPostgresValue(int value)
+    : type(Int), intValue(value) {}
+  NeonPostgresValue(unsigned int value)
+    : type(Int), intValue(value) {}
+  NeonPostgresValue(long value)
+    : type(Int), intValue(value) {}
+  NeonPostgresValue(unsigned long value)
+    : NeonPostgresValue(static_cast<unsigned long long>(value)) {}
+  NeonPostgresValue(long long value)
+    : type(Int), intValue(value) {}
+  NeonPostgresValue(unsigned long long value)
+    : type(value <= LLONG_MAX ? Int : Unsigned) {
+    if (type == Int) {
+      intValue = static_cast<long long>(value);
+    } else {
+      unsignedValue = value;
+    }
+  }
+  NeonPostgresValue(float value)
+    : type(Float), floatValue(value) {}
+  NeonPostgresValue(double value)
+    : type(Float), floatValue(value) {}
+  NeonPostgresValue(const char* value)
+    : type(value != nullptr ? Text : Null), textValue(value) {}
+
+  /**
+     * @brief Append the value to the parameter array of a statement, see
+     *        NeonPostgresOverHTTPProxyClient::getParams()
+     *
+     * @return false if the JsonDocument is out of memory
+     */
+  bool addTo(JsonArray params) const {
+    switch (type) {
+      case Bool:
+        return params.add(boolValue);
+      case Int:
+        return params.add(intValue);
+      case Unsigned:
+        return params.add(unsignedValue);
+      case Float:
+        return params.add(floatValue);
+      case Text:
+        return params.add(textValue);
+      default:
+        return params.add(nullptr);
+    }
+  }
+
+  /**
+     * @brief Approximate number of bytes the value needs in the Json request payload.
+     */
+  size_t jsonSize() const {
+    switch (type) {
+      case Bool:
+        return 6;
+      case Int:
+      case Unsigned:
+        return 21;
+      case Float:
+        return 16;
+      case Text:
+        return strlen(textValue) + 3;
+      default:
+        return 5;
+    }
+  }
+
+  /**
+     * @brief Write an Int or Unsigned value as decimal text, Print::print() has no 64-bit overload on every board.
+     *
+     * @return the text, it points into buffer
+     */
+  const char* formatInteger(char (&buffer)[21]) const {
+    bool negative = type == Int && intValue < 0;
+    unsigned long long rest = type == Unsigned ? unsignedValue
+                              : negative       ? 0ULL - static_cast<unsigned long long>(intValue)
+                                               : static_cast<unsigned long long>(intValue);
+    char* text = buffer + sizeof(buffer) - 1;
+    *text = 0;
+    do {
+      *--text = static_cast<char>('0' + rest % 10);
+      rest /= 10;
+    } while (rest > 0);
+    if (negative) {
+      *--text = '-';
+    }
+    return text;
+  }
+
+  Type type;
+  union {
+    bool boolValue;
+    long long intValue;
+    unsigned long long unsignedValue;
+    double floatValue;
+    const char* textValue;
+  };
+};
+
+#endif /* NEONPOSTGRESVALUE_H */
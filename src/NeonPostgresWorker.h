@@ -0,0 +1,320 @@
+// NeonPostgresOverHTTP - https://github.com/neondatabase-labs/NeonPostgresOverHTTP
+// Copyright © 2025, Peter Bendel and neondatabase labs (neon.tech)
+// MIT License
+
+#ifndef NEONPOSTGRESWORKER_H
+#define NEONPOSTGRESWORKER_H
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "NeonPostgresOverHTTP.h"
+#include "NeonPostgresValue.h"
+
+// maximum length of an error message returned in a NeonWorkerCompletion, longer messages are truncated
+#ifndef NEON_WORKER_MAX_ERROR_LENGTH
+#define NEON_WORKER_MAX_ERROR_LENGTH 64
+#endif
+
+/**
+ * @brief Lock-free ring buffer for exactly one producer and one consumer, for example an
+ *        interrupt service routine or loop() and a worker task.
+ *        The slots are part of the queue object, it never allocates memory.
+ *        Elements are filled and consumed in place to avoid copying them.
+ *
+ * @tparam T element type
+ * @tparam Capacity number of slots, must be a power of 2
+ */
+template <typename T, size_t Capacity>
+class NeonSpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+  // producer: the slot to fill next, nullptr if the queue is full
+  T* beginPush() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return nullptr;
+    }
+    return &slots[tail % Capacity];
+  }
+
+  // producer: publish the slot returned by beginPush() to the consumer
+  void commitPush() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // consumer: the oldest element, nullptr if the queue is empty
+  T* front() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_.load(std::memory_order_acquire) == head) {
+      return nullptr;
+    }
+    return &slots[head % Capacity];
+  }
+
+  // consumer: release the element returned by front() to the producer
+  void pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+  }
+
+private:
+  T slots[Capacity];
+  std::atomic<size_t> head_{ 0 };
+  std::atomic<size_t> tail_{ 0 };
+};
+
+/**
+ * @brief Outcome of a statement executed by NeonPostgresWorker
+ */
+struct NeonWorkerCompletion {
+  // id returned by NeonPostgresWorker::enqueue()
+  uint32_t id;
+  // true if errorMessage is set
+  bool failed;
+  // number of rows returned or affected
+  int rowCount;
+  // copy of the error message, empty on success
+  char errorMessage[NEON_WORKER_MAX_ERROR_LENGTH];
+};
+
+/**
+ * @brief Runs all network I/O of a NeonPostgresOverHTTPProxyClient (or another BasicNeonClient) in a dedicated FreeRTOS task (ESP32 only).
+ *        Producers enqueue statements and their parameters into a lock-free single-producer/single-consumer
+ *        ring buffer that never allocates memory, so they never wait for the network.
+ *        The worker task executes them one after the other and returns their outcome through a completion queue.
+ *
+ *        After begin() the worker task owns the client and its WiFiClient, do not use them from other tasks.
+ *        Only one task or interrupt service routine may enqueue statements.
+ * @example
+ * ```cpp
+ * NeonPostgresWorker<> worker(sqlClient);
+ *
+ * void setup() {
+ *   ...
+ *   worker.begin();
+ * }
+ *
+ * void loop() {
+ *   worker.enqueue(insertSensorValue, "temperature", temperature);
+ *   NeonWorkerCompletion completion;
+ *   while (worker.getCompletion(completion)) {
+ *     if (completion.failed) {
+ *       Serial.println(completion.errorMessage);
+ *     }
+ *   }
+ * }
+ * ```
+ *
+ * @tparam QueueLength number of statements that can be waiting, must be a power of 2
+ * @tparam MaxParams maximum number of parameters of a statement
+ * @tparam TextBytes buffer size per statement for the text parameters including their terminating 0
+ * @tparam Client the database client type, a BasicNeonClient
+ */
+template <size_t QueueLength = 16, size_t MaxParams = 4, size_t TextBytes = 48, typename Client = NeonPostgresOverHTTPProxyClient>
+class NeonPostgresWorker {
+public:
+  /**
+     * @brief Called in the worker task after each statement. The client still holds the result,
+     *        so rows can be read here.
+     */
+  typedef void (*ResultCallback)(const NeonWorkerCompletion& completion, Client& client, void* context);
+
+  NeonPostgresWorker(Client& client)
+    : client(client) {}
+
+  /**
+     * @brief Create the completion queue and start the worker task.
+     *
+     * @param priority FreeRTOS priority of the worker task
+     * @param stackSize stack size of the worker task in bytes
+     * @param core core to run the worker task on, tskNO_AFFINITY for any
+     *
+     * @return false if the task could not be created, for example for lack of memory. The worker is then
+     *         left as before the call and begin() can be called again
+     */
+  bool begin(UBaseType_t priority = 1, uint32_t stackSize = 8192, BaseType_t core = tskNO_AFFINITY) {
+    if (task != nullptr) {
+      return true;
+    }
+    if (completions == nullptr) {
+      completions = xQueueCreateStatic(QueueLength, sizeof(NeonWorkerCompletion), completionStorage, &completionQueue);
+    }
+    // the handle is stored before the task can run, so enqueue() never sees a started task as missing
+    return xTaskCreatePinnedToCore(run, "NeonPostgresWorker", stackSize, this, priority, &task, core) == pdPASS;
+  }
+
+  // maximum time in milliseconds to wait for the response to a statement
+  void setTimeout(unsigned long timeout) {
+    this->timeout = timeout;
+  }
+
+  /**
+     * @brief Set a function that is called in the worker task after each statement.
+     */
+  void setResultCallback(ResultCallback callback, void* context = nullptr) {
+    resultCallback = callback;
+    resultContext = context;
+  }
+
+  /**
+     * @brief Queue a statement for execution by the worker task. Never blocks and never allocates memory.
+     *        Statements queued before begin() are executed once the task has started.
+     *        Supported parameter types are bool, integers, float, double, const char* and nullptr for NULL.
+     *        Text parameters are copied.
+     *
+     * @param query SQL statement text. This pointer must be valid until the statement has been executed,
+     *              it is NOT copied, usually it is a constant.
+     *
+     * @return id of the statement used in its NeonWorkerCompletion, 0 if the queue is full or the text
+     *         parameters do not fit into TextBytes
+     */
+  template <typename... Values>
+  uint32_t enqueue(const char* query, Values... values) {
+    uint32_t id = push(query, values...);
+    if (id != 0 && task != nullptr) {
+      xTaskNotifyGive(task);
+    }
+    return id;
+  }
+
+  /**
+     * @brief Like enqueue(), for use in an interrupt service routine.
+     */
+  template <typename... Values>
+  uint32_t enqueueFromISR(const char* query, Values... values) {
+    uint32_t id = push(query, values...);
+    if (id != 0 && task != nullptr) {
+      BaseType_t higherPriorityTaskWoken = pdFALSE;
+      vTaskNotifyGiveFromISR(task, &higherPriorityTaskWoken);
+      portYIELD_FROM_ISR(higherPriorityTaskWoken);
+    }
+    return id;
+  }
+
+  /**
+     * @brief Get the outcome of the next executed statement without waiting.
+     *
+     * @return false if no statement has completed since the last call
+     */
+  bool getCompletion(NeonWorkerCompletion& completion) {
+    return completions != nullptr && xQueueReceive(completions, &completion, 0) == pdTRUE;
+  }
+
+  // number of completions dropped because nobody called getCompletion()
+  uint32_t getDroppedCompletions() const {
+    return droppedCompletions;
+  }
+
+private:
+  struct Statement {
+    uint32_t id;
+    const char* query;
+    size_t paramCount;
+    NeonPostgresValue params[MaxParams];
+    char text[TextBytes];
+    size_t textUsed;
+  };
+
+  template <typename... Values>
+  uint32_t push(const char* query, Values... values) {
+    static_assert(sizeof...(Values) <= MaxParams, "too many parameters for MaxParams");
+    Statement* statement = statements.beginPush();
+    if (statement == nullptr) {
+      return 0;
+    }
+    statement->query = query;
+    statement->paramCount = 0;
+    statement->textUsed = 0;
+    if (!storeParams(*statement, values...)) {
+      return 0;
+    }
+    nextId = nextId == UINT32_MAX ? 1 : nextId + 1;
+    statement->id = nextId;
+    statements.commitPush();
+    return statement->id;
+  }
+
+  bool storeParams(Statement&) {
+    return true;
+  }
+
+  template <typename Value, typename... Rest>
+  bool storeParams(Statement& statement, Value value, Rest... rest) {
+    NeonPostgresValue v(value);
+    if (v.type == NeonPostgresValue::Text) {
+      size_t len = strlen(v.textValue) + 1;
+      if (statement.textUsed + len > TextBytes) {
+        return false;
+      }
+      memcpy(statement.text + statement.textUsed, v.textValue, len);
+      v.textValue = statement.text + statement.textUsed;
+      statement.textUsed += len;
+    }
+    statement.params[statement.paramCount++] = v;
+    return storeParams(statement, rest...);
+  }
+
+  // milliseconds an idle worker waits for a notification before it checks the queue again
+  static const uint32_t IdlePoll = 100;
+
+  static void run(void* self) {
+    static_cast<NeonPostgresWorker*>(self)->work();
+  }
+
+  void work() {
+    while (true) {
+      Statement* statement = statements.front();
+      if (statement == nullptr) {
+        // the timeout also picks up a statement whose notification was lost
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IdlePoll));
+        continue;
+      }
+      NeonWorkerCompletion completion;
+      completion.id = statement->id;
+      client.setStaticQuery(statement->query);
+      JsonArray params = client.getParams();
+      params.clear();
+      for (size_t i = 0; i < statement->paramCount; i++) {
+        statement->params[i].addTo(params);
+      }
+      // the parameters have been copied into the client, the query text is only referenced and used until
+      // execute() returns, which the caller guarantees. Free the slot for the producer
+      statements.pop();
+      const char* errorMessage = client.execute(timeout);
+      completion.failed = errorMessage != nullptr;
+      completion.rowCount = completion.failed ? 0 : client.getRowCount();
+      strncpy(completion.errorMessage, completion.failed ? errorMessage : "", sizeof(completion.errorMessage) - 1);
+      completion.errorMessage[sizeof(completion.errorMessage) - 1] = 0;
+      if (resultCallback != nullptr) {
+        resultCallback(completion, client, resultContext);
+      }
+      if (xQueueSend(completions, &completion, 0) != pdTRUE) {
+        droppedCompletions++;
+      }
+    }
+  }
+
+  Client& client;
+  NeonSpscQueue<Statement, QueueLength> statements;
+  uint32_t nextId = 0;
+  unsigned long timeout = 20000;
+  ResultCallback resultCallback = nullptr;
+  void* resultContext = nullptr;
+  TaskHandle_t task = nullptr;
+  QueueHandle_t completions = nullptr;
+  StaticQueue_t completionQueue;
+  uint8_t completionStorage[QueueLength * sizeof(NeonWorkerCompletion)];
+  volatile uint32_t droppedCompletions = 0;
+};
+
+#endif /* ARDUINO_ARCH_ESP32 */
+
+#endif /* NEONPOSTGRESWORKER_H */